@@ -0,0 +1,13 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <stdbool.h>
+
+// Compiled-in king and pawn versus king bitbase, generated at build time
+// by chess_kpkgen. Squares are numbered a1 = 0 ... h8 = 63 and the side
+// with the pawn is passed as white; mirror the board first if needed.
+
+// True if the side with the pawn wins with best play
+bool kpkProbe(int whiteKing, int whitePawn, int blackKing, bool whiteToMove);
+
+#endif // BITBASE_H
@@ -0,0 +1,41 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game_logic.h"
+#include "platform.h"
+
+// Polyglot .bin opening books. The file is memory mapped and searched in
+// place, so books of any size open instantly.
+
+// Each entry is 16 big-endian bytes, sorted by key
+#define BOOK_ENTRY_SIZE 16
+#define BOOK_MAX_MOVES 64
+
+typedef struct {
+    MappedFile file;
+    size_t count;
+} OpeningBook;
+
+typedef struct {
+    Move move;
+    uint16_t weight;
+} BookMove;
+
+bool bookOpen(OpeningBook *book, const char *path);
+void bookClose(OpeningBook *book);
+
+// Legal book moves for the position. Returns how many were found.
+int bookProbe(const OpeningBook *book, const GameState *game, BookMove *moves, int maxMoves);
+
+// Picks a book move at random, proportionally to the entry weights.
+// seed is advanced in place, so each thread should use its own.
+bool bookPickMove(const OpeningBook *book, const GameState *game, uint64_t *seed, Move *move);
+
+// Conversions between Move and Polyglot's 16-bit move encoding, which
+// writes castling as the king capturing its own rook
+uint16_t bookEncodeMove(const GameState *game, Move move);
+Move bookDecodeMove(const GameState *game, uint16_t encoded);
+
+#endif // BOOK_H
@@ -0,0 +1,33 @@
+#ifndef EVALUATE_H
+#define EVALUATE_H
+
+#include "game_logic.h"
+
+// Piece values in centipawns
+#define PAWN_VALUE 100
+#define KNIGHT_VALUE 320
+#define BISHOP_VALUE 330
+#define ROOK_VALUE 500
+#define QUEEN_VALUE 900
+
+// Score of a known win from an endgame bitbase, well above any material
+// balance so the search heads for it
+#define KNOWN_WIN 10000
+
+// Layout of the tunable weights in eval_weights.h: one value per piece
+// type from pawn to king, then a 64 entry square table per piece type.
+// Tables are seen from white's side in board order (a8 = 0, h1 = 63);
+// black pieces use the vertically mirrored square.
+#define EVAL_PIECE_VALUES 0
+#define EVAL_PIECE_SQUARES 6
+#define EVAL_WEIGHT_COUNT (6 + 6 * 64)
+
+// Weight indices of the two terms for a piece on board[y][x]
+#define EVAL_VALUE_INDEX(type) (EVAL_PIECE_VALUES + (type) - 1)
+#define EVAL_SQUARE_INDEX(type, color, x, y) \
+    (EVAL_PIECE_SQUARES + ((type) - 1) * 64 + ((color) == COLOR_WHITE ? (y) : 7 - (y)) * 8 + (x))
+
+// Static evaluation in centipawns from the side to move's point of view
+int evaluate(const GameState *game);
+
+#endif // EVALUATE_H
@@ -0,0 +1,26 @@
+#ifndef FEN_H
+#define FEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "game_logic.h"
+
+// Standard starting position
+#define FEN_START "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Longest FEN gameToFEN can write, including the terminator
+#define FEN_MAX_LENGTH 96
+
+// Loads a position from Forsyth-Edwards Notation. The move counters are
+// optional and ignored, so EPD lines load too. Positions without exactly
+// one king per side, with pawns on the back ranks, with castling rights
+// whose king or rook is not at home or with an en passant square no pawn
+// can have skipped are rejected. game is left untouched on failure.
+// Nothing is allocated.
+bool gameFromFEN(const char *fen, GameState *game);
+
+// Writes the position as FEN and returns its length. The move counters
+// are not tracked, so they are always written as "0 1".
+size_t gameToFEN(const GameState *game, char fen[FEN_MAX_LENGTH]);
+
+#endif // FEN_H
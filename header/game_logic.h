@@ -2,7 +2,7 @@
 #define GAME_LOGIC_H
 
 #include <stdbool.h>
-#include "pieces.h"
+#include <stdint.h>
 
 // Piece types
 typedef enum {
@@ -22,47 +22,110 @@ typedef enum {
     COLOR_BLACK
 } ColorPieces;
 
-// Piece structure
-typedef struct {
-    PieceType type;
-    ColorPieces color;
-    bool hasMoved;  // For pawns, kings, rooks (castling)
-} Piece;
+// A piece in one byte: PieceType in bits 0-2 and ColorPieces in bits 3-4.
+// An empty square is 0.
+typedef uint8_t Piece;
 
-// Move structure
-typedef struct {
-    int fromX;
-    int fromY;
-    int toX;
-    int toY;
-} Move;
+#define PIECE(type, color) ((Piece)((type) | (color) << 3))
+#define PIECE_TYPE(piece) ((PieceType)((piece) & 7))
+#define PIECE_COLOR(piece) ((ColorPieces)(((piece) >> 3) & 3))
+
+// The board is a 10x12 mailbox: the 8x8 squares sit inside a border one
+// file wide at the sides and two ranks deep at the top and bottom, so
+// any king, knight or ray step off the board lands on a border square.
+// Border squares hold OFFBOARD, which is neither empty nor of either
+// color, so ray walks stop there without bounds checks.
+#define BOARD_SIZE 120
+#define OFFBOARD ((Piece)0xff)
+#define IS_OFFBOARD(piece) ((piece) & 0x80)
+
+// Mailbox index of board coordinates; y = 0 is rank 8
+#define SQUARE(x, y) (((y) + 2) * 10 + (x) + 1)
+#define SQUARE_X(square) ((square) % 10 - 1)
+#define SQUARE_Y(square) ((square) / 10 - 2)
+
+// A move in 16 bits: from square in bits 0-5 and to square in bits 6-11
+// (y * 8 + x each), the kind of move in bits 12-13 and, for promotions,
+// the new piece in bits 14-15
+typedef uint16_t Move;
+
+typedef enum {
+    MOVE_NORMAL,
+    MOVE_PROMOTION,
+    MOVE_EN_PASSANT,
+    MOVE_CASTLING
+} MoveKind;
 
-// Game state
+// No legal move goes from a square to itself
+#define MOVE_NONE ((Move)0)
+
+#define MOVE(fromX, fromY, toX, toY) \
+    ((Move)(((fromY) * 8 + (fromX)) | ((toY) * 8 + (toX)) << 6))
+#define MOVE_WITH_KIND(fromX, fromY, toX, toY, kind) \
+    ((Move)(MOVE(fromX, fromY, toX, toY) | (kind) << 12))
+#define MOVE_PROMOTING(fromX, fromY, toX, toY, piece) \
+    ((Move)(MOVE(fromX, fromY, toX, toY) | MOVE_PROMOTION << 12 | ((piece) - KNIGHT) << 14))
+
+#define MOVE_FROM(move) ((move) & 63)
+#define MOVE_TO(move) (((move) >> 6) & 63)
+#define MOVE_FROM_X(move) ((move) & 7)
+#define MOVE_FROM_Y(move) (((move) >> 3) & 7)
+#define MOVE_TO_X(move) (((move) >> 6) & 7)
+#define MOVE_TO_Y(move) (((move) >> 9) & 7)
+#define MOVE_KIND(move) ((MoveKind)(((move) >> 12) & 3))
+// The piece a pawn becomes, EMPTY for other moves
+#define MOVE_PROMOTION_PIECE(move) \
+    (MOVE_KIND(move) == MOVE_PROMOTION ? (PieceType)(KNIGHT + ((move) >> 14)) : EMPTY)
+// Mailbox squares of the two ends
+#define MOVE_FROM_SQUARE(move) SQUARE(MOVE_FROM_X(move), MOVE_FROM_Y(move))
+#define MOVE_TO_SQUARE(move) SQUARE(MOVE_TO_X(move), MOVE_TO_Y(move))
+
+// Upper bound on the number of legal moves in any position
+#define MAX_MOVES 256
+
+// Castling rights, in GameState.castling
+#define CASTLE_WHITE_SHORT 1
+#define CASTLE_WHITE_LONG 2
+#define CASTLE_BLACK_SHORT 4
+#define CASTLE_BLACK_LONG 8
+
+// Game state, 128 bytes so that search can copy it per node. Everything
+// but the board, the last move and the king squares shares a single word.
 typedef struct {
-    Piece board[8][8];
-    ColorPieces currentTurn;
-    bool isCheck;
-    bool isCheckmate;
-    bool isStalemate;
+    Piece board[BOARD_SIZE];  // Indexed by SQUARE(x, y)
     Move lastMove;
-    // For en passant and castling
-    bool canEnPassant;
-    int enPassantCol;
-    int enPassantRow;
-    bool canCastle;
-    bool canCastleLong;
-    bool canCastleShort;
+    uint8_t kingSquare[2];     // Use KING_SQUARE
+    unsigned currentTurn : 2;  // ColorPieces
+    unsigned isCheck : 1;
+    unsigned isCheckmate : 1;
+    unsigned isStalemate : 1;
+    unsigned castling : 4;     // CASTLE_* rights still held
+    unsigned enPassant : 7;    // Square a pawn just skipped over, 0 for none
 } GameState;
 
+// Square of the king of this color, 0 while it has none
+#define KING_SQUARE(game, color) ((game)->kingSquare[(color) - COLOR_WHITE])
+
 // Function declarations
 GameState initializeGame(void);
+// An empty board with white to move, for setting up positions
+GameState emptyGame(void);
 bool isValidMove(GameState *game, int fromX, int fromY, int toX, int toY);
 bool is_king_in_check(GameState* game, ColorPieces color);
+// Builds the move of the piece on from to the square to, with the kind
+// the position implies. promotion is the piece for a pawn reaching the
+// last rank; EMPTY picks a queen.
+Move moveFromSquares(const GameState *game, int fromX, int fromY, int toX, int toY, PieceType promotion);
 bool makeMove(GameState *game, Move move);
+void applyMove(GameState *game, Move move);
 bool isInCheck(GameState *game, ColorPieces color);
+// Whether the side to move has any legal move, stopping at the first
+bool hasAnyLegalMove(GameState *game);
+// These also set game->isCheckmate and game->isStalemate
 bool isCheckmate(GameState *game);
 bool isStalemate(GameState *game);
 bool isKingCheckmated(GameState *game);
 void getPossibleMoves(GameState *game, int x, int y, bool moves[8][8]);
+int generateLegalMoves(GameState *game, Move *moves);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef GAMEDB_H
+#define GAMEDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+#include "pgn.h"
+#include "platform.h"
+
+// Game database with a position index, built by tools/gamedb.c. The file
+// is memory mapped and searched in place, so a query touches only the
+// pages it needs and databases of any size open instantly.
+//
+// Layout, all numbers little endian:
+//   header   GAMEDB_HEADER_SIZE bytes: magic, version, game count, move
+//            bytes and index entry count
+//   offsets  (games + 1) x 8 bytes: where each game's moves start
+//   results  games x 1 byte: GameResult
+//   moves    every game from the initial position, entropy coded by
+//            moveCodecEncode
+//   index    entries x 12 bytes: position key, game id, sorted by both;
+//            a position reached twice in a game is listed once
+
+#define GAMEDB_MAGIC "CHESSGDB"
+#define GAMEDB_VERSION 2
+#define GAMEDB_HEADER_SIZE 64
+#define GAMEDB_ENTRY_SIZE 12
+
+typedef struct {
+    MappedFile file;
+    uint64_t gameCount;
+    uint64_t moveBytes;
+    uint64_t entryCount;
+    const unsigned char *offsets;
+    const unsigned char *results;
+    const unsigned char *moves;
+    const unsigned char *index;
+} GameDb;
+
+bool gameDbOpen(GameDb *db, const char *path);
+void gameDbClose(GameDb *db);
+
+// Ids of the games that reached the position with this zobristKey, in
+// ascending order. Up to maxGames are stored; returns how many there are.
+uint64_t gameDbFind(const GameDb *db, uint64_t key, uint32_t *games, uint64_t maxGames);
+
+GameResult gameDbResult(const GameDb *db, uint32_t game);
+
+// Decodes the moves of a game and returns how many there are, or -1 if
+// the game does not exist, is longer than maxMoves or stops before its
+// declared length
+int gameDbMoves(const GameDb *db, uint32_t game, Move *moves, int maxMoves);
+
+#endif // GAMEDB_H
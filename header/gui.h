@@ -10,6 +10,9 @@
 #define CAPTURE_SOUND ASSET_PATH "sounds/capture.mp3"
 #define INTRO_IMAGE ASSET_PATH "images/chessboard.png"
 
+// Finished games are appended here, relative to the working directory
+#define PGN_EXPORT_PATH "games.pgn"
+
 void gameState(void);
 
 #endif // GUI_H
@@ -0,0 +1,58 @@
+#ifndef MOVECODEC_H
+#define MOVECODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+#include "pgn.h"
+
+// Compact game encoding. Each move is stored as its index in the legal
+// moves of the position, ordered by a fixed heuristic that puts likely
+// moves first: one byte per move, or usually well under one when the
+// indices are entropy coded. Decoding replays the game, so it runs at
+// move generation speed. The ordering is part of the format and must
+// never change.
+//
+// An encoded game is its ply count as a varint followed by the moves.
+// Raw moves are one byte each, 255 escaping larger indices as 255 plus a
+// varint. Entropy coded moves use an adaptive binary range coder that
+// starts afresh for every game, so games decode independently.
+
+// Most bytes an encoded game of this many plies can take
+#define MOVE_CODEC_BOUND(plies) (16 + (size_t)(plies) * 12)
+
+// Bit models of the range coder
+#define MOVE_CODEC_BUCKETS 12
+
+typedef struct {
+    uint16_t bucket[16];
+    uint16_t bits[MOVE_CODEC_BUCKETS][MOVE_CODEC_BUCKETS];
+} MoveCodecModel;
+
+typedef struct {
+    GameState game;  // Position before the next move
+    int pliesLeft;
+    bool entropy;
+    const unsigned char *cursor;
+    const unsigned char *end;
+    uint32_t range;
+    uint32_t code;
+    MoveCodecModel model;
+} MoveDecoder;
+
+// Encodes plies moves played from start into out, which must hold
+// MOVE_CODEC_BOUND(plies) bytes. Returns the length, or 0 if a move is
+// not legal.
+size_t moveCodecEncode(const GameState *start, const Move *moves, int plies, bool entropy,
+                       unsigned char *out);
+
+// Reads the ply count and prepares to replay the game from start
+bool moveDecoderStart(MoveDecoder *decoder, const GameState *start, const unsigned char *data,
+                      size_t length, bool entropy);
+
+// Decodes the next move and plays it on decoder->game. Returns false at
+// the end of the game or for corrupt data.
+bool moveDecoderNext(MoveDecoder *decoder, Move *move);
+
+#endif // MOVECODEC_H
@@ -0,0 +1,62 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+#include "pgn.h"
+#include "platform.h"
+
+// Fixed-size binary positions for training and test sets. A position file
+// is nothing but records back to back, so it is memory mapped and indexed
+// directly and files from several writers can simply be concatenated.
+
+#define PACKED_POSITION_SIZE 32
+
+// Byte layout, the same on every machine:
+//   occupancy  bit y * 8 + x set for each occupied square
+//   pieces     one nibble per occupied square in square order, low nibble
+//              first: type | 8 for black
+//   state      bit 0 black to move, bits 1-4 castling rights KQkq
+//   enPassant  file + 1 of the en passant square, 0 for none
+//   fullmove   and score are little endian; score is in centipawns from
+//              white's point of view
+typedef struct {
+    uint8_t occupancy[8];
+    uint8_t pieces[16];
+    uint8_t state;
+    uint8_t enPassant;
+    uint8_t halfmoveClock;
+    uint8_t fullmove[2];
+    uint8_t score[2];
+    uint8_t result;  // GameResult of the game the position came from
+} PackedPosition;
+
+// What a record holds besides the position itself
+typedef struct {
+    int halfmoveClock;
+    int fullmove;
+    int score;
+    GameResult result;
+} PackedInfo;
+
+typedef struct {
+    MappedFile file;
+    const PackedPosition *positions;
+    size_t count;
+} PackedFile;
+
+// Encodes a position. info may be NULL for clocks 0 and 1, score 0 and no
+// result; values out of range are clamped.
+void packPosition(const GameState *game, const PackedInfo *info, PackedPosition *packed);
+
+// Decodes a record the way gameFromFEN would load the same position.
+// Fails for records no valid position encodes to. info may be NULL.
+bool unpackPosition(const PackedPosition *packed, GameState *game, PackedInfo *info);
+
+// Maps a position file. Fails unless the size is a whole number of records.
+bool packedOpen(PackedFile *file, const char *path);
+void packedClose(PackedFile *file);
+
+#endif // PACKED_H
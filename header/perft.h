@@ -0,0 +1,43 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "game_logic.h"
+
+// Move generator test: counts the leaf nodes of the legal move tree.
+// Known totals for standard positions catch rules bugs quickly.
+
+#define PERFT_MAX_THREADS 256
+#define PERFT_DEFAULT_HASH_MB 64
+
+// Deepest ply at which the parallel tree is split into subtrees
+#define PERFT_MAX_SPLIT 6
+#define PERFT_DEFAULT_SPLIT 2
+
+// Work done by one thread of perftParallel
+typedef struct {
+    unsigned long long nodes;  // Leaf nodes below the subtrees it searched
+    int tasks;                 // Subtrees searched
+    int steals;                // Times it took work from another thread
+    long long timeMs;          // From the start until it ran out of work
+} PerftThreadStats;
+
+// Resizes the table of subtree counts shared by all perft threads, which
+// is also cleared. 0 turns hashing off. Must not be called during perft.
+bool perftSetHash(size_t megabytes);
+void perftClearHash(void);
+
+// Leaf nodes depth plies below the position, on the calling thread. The
+// last ply is counted without playing its moves, and subtrees found in
+// the table are not searched again.
+unsigned long long perft(const GameState *game, int depth);
+
+// The same count, with the tree split splitDepth plies below the root into
+// subtrees that the threads share by work stealing. stats, if not NULL,
+// receives one entry per requested thread. Falls back to the calling
+// thread alone when memory is short.
+unsigned long long perftParallel(const GameState *game, int depth, int splitDepth,
+                                 int threads, PerftThreadStats *stats);
+
+#endif // PERFT_H
@@ -0,0 +1,80 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+#include "platform.h"
+
+// Reader for PGN game collections. The file is memory-mapped and games
+// point straight into it, so nothing is copied or allocated per game and
+// files of any size can be read. A file can be split into chunks at game
+// boundaries for threads to read in parallel.
+
+typedef enum {
+    RESULT_NONE,  // "*" or missing
+    RESULT_WHITE_WINS,
+    RESULT_BLACK_WINS,
+    RESULT_DRAW
+} GameResult;
+
+// One game as found in the file. tags and movetext point into the mapped
+// file and are not NUL terminated; they stay valid until pgnClose.
+typedef struct {
+    GameResult result;
+    bool hasSetup;  // Starts from a [FEN] position instead of the initial one
+    const char *tags;
+    size_t tagsLength;
+    const char *movetext;
+    size_t movetextLength;
+} PgnGame;
+
+typedef struct {
+    MappedFile file;
+    bool ownsFile;  // False for chunks made by pgnSplit
+    const char *cursor;
+    const char *end;
+} PgnReader;
+
+#define PGN_MAX_PLIES 2048
+
+// Longest SAN moveToSan writes, such as "exd8=Q#", with the terminator
+#define PGN_MAX_SAN 8
+
+bool pgnOpen(PgnReader *reader, const char *path);
+void pgnClose(PgnReader *reader);
+
+// Sets chunk to part index of count roughly equal parts of the reader's
+// remaining games. Parts start at game boundaries, so every game lands in
+// exactly one of them. The chunk shares the mapping and must not outlive
+// the reader; closing it is optional.
+void pgnSplit(const PgnReader *reader, int index, int count, PgnReader *chunk);
+
+// Reads the next game. Returns false at the end of the file or chunk.
+bool pgnReadGame(PgnReader *reader, PgnGame *game);
+
+// Finds a tag such as "White" and points value at its text, without the
+// quotes. Escaped characters are left as they are.
+bool pgnTag(const PgnGame *game, const char *name, const char **value, size_t *length);
+
+// Steps through movetext, skipping move numbers, comments, variations,
+// NAGs and the result. Sets san/length to the next move and advances
+// cursor past it. Returns false when no moves are left.
+bool pgnNextSan(const char **cursor, const char *end, const char **san, size_t *length);
+
+// Resolves a SAN move against the legal moves of the position. Fails for
+// illegal or ambiguous moves and for pawn moves to the last rank without
+// a piece.
+bool sanToMove(GameState *game, const char *san, size_t length, Move *move);
+
+// Writes a legal move in SAN, with the least disambiguation needed and a
+// check or mate mark. Returns the length.
+size_t moveToSan(GameState *game, Move move, char san[PGN_MAX_SAN]);
+
+// Sets game to the initial position or the one from the [FEN] tag, then
+// plays the whole movetext, storing up to maxMoves moves. Returns the
+// number of plies, or -1 if the setup or a move cannot be read.
+int pgnDecodeGame(const PgnGame *pgn, GameState *game, Move *moves, int maxMoves);
+
+#endif // PGN_H
@@ -0,0 +1,43 @@
+#ifndef PGN_WRITER_H
+#define PGN_WRITER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "pgn.h"
+
+// Writes finished games as PGN. A PgnWriter appends games to a file on a
+// background thread, so callers such as the GUI's render loop never wait
+// for the disk.
+
+#define PGN_NAME_LENGTH 64
+
+// A game as it was played, kept compact until it is written out
+typedef struct {
+    char white[PGN_NAME_LENGTH];
+    char black[PGN_NAME_LENGTH];
+    char date[11];               // "YYYY.MM.DD"; empty for unknown
+    GameResult result;
+    GameState start;             // Position before the first move
+    int plyCount;
+    Move moves[PGN_MAX_PLIES];
+    int moveMs[PGN_MAX_PLIES];   // Time spent on each move, -1 if unknown
+} PgnRecord;
+
+// Writes one game with the seven standard tags, SetUp/FEN for games that
+// do not start from the initial position and an [%emt] comment with the
+// time spent on each move
+bool pgnWriteGame(FILE *file, const PgnRecord *record);
+
+typedef struct PgnWriter PgnWriter;
+
+// Starts the background thread. Games are appended to path, which is
+// opened for each game so a crash loses nothing already written.
+PgnWriter *pgnWriterStart(const char *path);
+
+// Queues a copy of the game and returns at once
+bool pgnWriterSubmit(PgnWriter *writer, const PgnRecord *record);
+
+// Writes every queued game, then stops the thread and frees the writer
+void pgnWriterStop(PgnWriter *writer);
+
+#endif // PGN_WRITER_H
@@ -0,0 +1,59 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Small portability layer for the headless tools and engine code.
+// Everything OS specific lives behind these functions.
+
+// Read-only view of a whole file, paged in by the OS on demand
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    void *fileHandle;
+    void *mapHandle;
+} MappedFile;
+
+// Child process with pipes connected to its stdin and stdout
+typedef struct {
+    FILE *input;   // Written by us, read by the child
+    FILE *output;  // Written by the child, read by us
+    void *handle;
+    long pid;
+} ChildProcess;
+
+// Number of logical processors available to the process (at least 1)
+int platformCpuCount(void);
+
+// Monotonic clock for measuring elapsed time, unrelated to wall time
+long long platformMilliseconds(void);
+
+// Maps a file read-only. Empty files cannot be mapped.
+bool platformMapFile(const char *path, MappedFile *file);
+void platformUnmapFile(MappedFile *file);
+
+// Runs command through the system shell. Both streams are line buffered
+// from our side.
+bool platformSpawn(const char *command, ChildProcess *child);
+
+// Outcome of platformReadLine
+typedef enum {
+    PLATFORM_READ_LINE,
+    PLATFORM_READ_TIMEOUT,
+    PLATFORM_READ_CLOSED
+} PlatformReadResult;
+
+// Reads one line from the child without its line ending, waiting at most
+// timeoutMs for it. A line longer than size is cut at size - 1 characters
+// and the rest is dropped.
+PlatformReadResult platformReadLine(ChildProcess *child, char *line, size_t size, int timeoutMs);
+
+// Closes the pipes and waits for the child to exit
+void platformCloseProcess(ChildProcess *child);
+
+// Kills the child first, for one that stopped responding
+void platformKillProcess(ChildProcess *child);
+
+#endif // PLATFORM_H
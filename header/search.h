@@ -0,0 +1,81 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+
+// Iterative deepening alpha-beta search with a shared transposition
+// table. Extra threads search the same tree (lazy SMP) and only help by
+// filling the table.
+
+#define SEARCH_MAX_PLY 64
+#define SEARCH_MAX_THREADS 256
+#define SEARCH_DEFAULT_HASH_MB 16
+
+// Mate scores are SCORE_MATE minus the distance to mate in plies
+#define SCORE_MATE 32000
+#define SCORE_INFINITE 32500
+#define SCORE_MATE_BOUND (SCORE_MATE - SEARCH_MAX_PLY)
+
+typedef struct {
+    int depth;          // 0 = no limit
+    long long nodes;    // 0 = no limit
+    int moveTime;       // Fixed time per move in ms, 0 = none
+    int time[2];        // Remaining clock in ms for white and black, 0 = none
+    int increment[2];
+    int movesToGo;      // 0 = sudden death
+    bool infinite;      // Run until searchStop
+    bool ponder;        // Run until searchStop or searchPonderHit
+} SearchLimits;
+
+// Progress report after each completed iteration
+typedef struct {
+    int depth;
+    int score;          // Centipawns from the side to move's point of view
+    long long nodes;
+    long long timeMs;
+    int pvLength;
+    Move pv[SEARCH_MAX_PLY];
+} SearchInfo;
+
+typedef void (*SearchInfoCallback)(const SearchInfo *info, void *context);
+
+// Resizes the transposition table, which is also cleared. Must not be
+// called during a search.
+bool searchSetHash(size_t megabytes);
+void searchClearHash(void);
+
+// Starts searching the position on background threads and returns at
+// once. history holds the keys of earlier positions in the game so
+// repetitions are scored as draws. Fails if there is no legal move or a
+// search is already running.
+bool searchStart(const GameState *game, const uint64_t *history, int historyLength,
+                 const SearchLimits *limits, int threads,
+                 SearchInfoCallback callback, void *context);
+
+// Waits for the search to end and returns the best move, plus the
+// expected reply in ponder when one is known (otherwise MOVE_NONE)
+bool searchWait(Move *best, Move *ponder);
+
+// searchStart followed by searchWait
+bool searchRun(const GameState *game, const uint64_t *history, int historyLength,
+               const SearchLimits *limits, int threads,
+               SearchInfoCallback callback, void *context, Move *best, Move *ponder);
+
+// Searches on the calling thread alone until limits->depth or
+// limits->nodes is reached; one of them must be set. Only the
+// transposition table is shared, so any number of threads may run local
+// searches at once, each on its own game, and a search started with
+// searchStart is unaffected. searchSetHash must have been called first.
+// score is from the side to move's point of view and may be NULL. Fails
+// if there is no move to search.
+bool searchLocal(const GameState *game, const uint64_t *history, int historyLength,
+                 const SearchLimits *limits, Move *best, int *score);
+
+// Thread safe controls for a running search
+void searchStop(void);
+void searchPonderHit(void);
+
+#endif // SEARCH_H
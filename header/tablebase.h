@@ -0,0 +1,94 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game_logic.h"
+
+// Endgame tablebases for pawnless material signatures of up to five
+// pieces, built by retrograde analysis. Pawns are left out, which keeps
+// every table closed under the moves of its pieces.
+
+#define TB_MAX_PIECES 5
+#define TB_FILE_EXTENSION ".ctb"
+
+// Entry values, always from the point of view of the side to move.
+// Any other value v means mate in (v - 1) plies: an odd distance is a
+// win for the side to move, an even one a loss (1 = checkmated now).
+#define TB_DRAW 0
+#define TB_ILLEGAL 255
+
+// Tablebase squares are numbered a1 = 0 ... h8 = 63
+#define TB_SQUARE(file, rank) ((rank) * 8 + (file))
+
+// Number of non-adjacent king pairs left after the 8-fold board symmetry
+#define TB_KING_PAIRS 462
+
+// Upper bound on the number of pawnless signatures with TB_MAX_PIECES
+#define TB_MAX_SIGNATURES 256
+
+// A position reduced to its pieces. Tables store their pieces in a fixed
+// order: white king, white pieces from queen down to knight, then the
+// same for black. White is always the side with more material.
+typedef struct {
+    int count;
+    PieceType type[TB_MAX_PIECES];
+    ColorPieces color[TB_MAX_PIECES];
+    int square[TB_MAX_PIECES];
+} TbPieceList;
+
+// Where a position is stored: table name, side to move inside that table
+// (0 = white, 1 = black) and the entry index within that side
+typedef struct {
+    char name[16];
+    int side;
+    uint32_t index;
+} TbLocation;
+
+// On-disk format, little endian: the header, blockCount + 1 offsets
+// (uint64_t, from the start of the file), then the compressed blocks.
+// Both sides are stored back to back, white to move first, and split into
+// TB_BLOCK_SIZE byte blocks that are compressed independently.
+#define TB_MAGIC 0x31425443u // "CTB1"
+#define TB_VERSION 1
+#define TB_BLOCK_SIZE 8192
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    char name[16];
+    uint32_t pieceCount;
+    uint32_t entries;    // entries per side to move
+    uint32_t blockSize;
+    uint32_t blockCount;
+} TbFileHeader;
+
+// Normalizes a signature such as "KvKRN" to its table name ("KRNvK")
+bool tbCanonicalName(const char *signature, char name[16]);
+
+// Lists the table names of every pawnless signature with up to maxPieces
+// pieces, smaller tables first. Returns how many were written.
+int tbListSignatures(int maxPieces, char names[][16], int capacity);
+
+// Number of entries per side to move for a table of pieceCount pieces
+uint32_t tbEntriesPerSide(int pieceCount);
+
+// Maps a position to its table entry. Fails for positions that have no
+// table (bare kings, pawns, too many pieces) or touching kings.
+bool tbLocate(const TbPieceList *pieces, ColorPieces sideToMove, TbLocation *location);
+
+// Block codec used by the on-disk format. Decompression fails on corrupt
+// input or if the output does not fill exactly dstSize bytes.
+size_t tbCompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst);
+bool tbDecompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize);
+
+// Writes directory/<name>.ctb to path. Fails if it does not fit in size.
+bool tbTablePath(const char *directory, const char *name, char *path, size_t size);
+
+// Builds directory/<name>.ctb with the given number of worker threads.
+// Missing sub-tables reachable by captures are generated first; tables
+// already on disk are reused.
+bool tbGenerate(const char *signature, const char *directory, int threads);
+
+#endif // TABLEBASE_H
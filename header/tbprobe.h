@@ -0,0 +1,46 @@
+#ifndef TBPROBE_H
+#define TBPROBE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "game_logic.h"
+
+// Read-only access to the tables written by the tablebase generator.
+// Table files are memory mapped; blocks are decompressed on demand into
+// a cache shared by all threads.
+
+#define TB_DEFAULT_CACHE_BYTES (32u << 20)
+
+// Win/draw/loss for the side to move
+typedef enum {
+    TB_LOSS = -1,
+    TB_WDL_DRAW = 0,
+    TB_WIN = 1
+} TbWdl;
+
+// Maps every table found in directory and sets up the block cache.
+// Returns the number of tables found. Not thread safe; call before
+// probing from other threads.
+int tbProbeInit(const char *directory, size_t cacheBytes);
+void tbProbeClose(void);
+
+// Largest piece count that has a table, 0 when none are loaded. Lets
+// callers skip positions with too many pieces without probing.
+int tbProbePieces(void);
+
+// Result only, for the search. The tables store nothing but DTM, so this
+// reads and decodes the same entry as tbProbeDTM and drops the distance;
+// it costs the same. Fails if the position has no table (castling
+// rights, pawns, too many pieces).
+bool tbProbeWDL(const GameState *game, TbWdl *wdl);
+
+// Result plus distance to mate in plies (0 for draws and for a side
+// that is already checkmated)
+bool tbProbeDTM(const GameState *game, TbWdl *wdl, int *plies);
+
+// Picks the move that keeps the best result at the root: the fastest
+// mate, a drawing move, or the longest defence. wdl and plies describe
+// the position after playing it, from the root side's point of view.
+bool tbProbeRoot(const GameState *game, Move *best, TbWdl *wdl, int *plies);
+
+#endif // TBPROBE_H
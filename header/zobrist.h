@@ -0,0 +1,22 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+#include "game_logic.h"
+
+// Position keys laid out like Polyglot's: 768 piece/square keys, 4
+// castling keys, 8 en passant file keys and one side to move key.
+#define ZOBRIST_PIECE 0
+#define ZOBRIST_CASTLE 768
+#define ZOBRIST_EN_PASSANT 772
+#define ZOBRIST_TURN 780
+#define ZOBRIST_KEYS 781
+
+// Key of a full position, computed from scratch
+uint64_t zobristKey(const GameState *game);
+
+// Individual keys, for code that updates a key incrementally
+uint64_t zobristPieceKey(Piece piece, int x, int y);
+uint64_t zobristTurnKey(void);
+
+#endif // ZOBRIST_H
@@ -0,0 +1,18 @@
+#include "bitbase.h"
+#include <stdint.h>
+
+// Defined in the generated kpk_bitbase.c, one bit per position
+extern const uint32_t kpkBitbase[];
+
+bool kpkProbe(int whiteKing, int whitePawn, int blackKing, bool whiteToMove) {
+    // The table only covers pawns on files a-d
+    if ((whitePawn & 7) > 3) {
+        whiteKing ^= 7;
+        whitePawn ^= 7;
+        blackKing ^= 7;
+    }
+
+    int index = (whiteToMove ? 0 : 1) | (blackKing << 1) | (whiteKing << 7) |
+                ((whitePawn & 7) << 13) | ((6 - (whitePawn >> 3)) << 15);
+    return (kpkBitbase[index >> 5] >> (index & 31)) & 1;
+}
@@ -0,0 +1,118 @@
+#include "book.h"
+#include "zobrist.h"
+#include <string.h>
+
+static uint64_t readBig(const unsigned char *bytes, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+bool bookOpen(OpeningBook *book, const char *path) {
+    memset(book, 0, sizeof(*book));
+    if (!platformMapFile(path, &book->file)) return false;
+    if (book->file.size % BOOK_ENTRY_SIZE != 0) {
+        platformUnmapFile(&book->file);
+        return false;
+    }
+    book->count = book->file.size / BOOK_ENTRY_SIZE;
+    return true;
+}
+
+void bookClose(OpeningBook *book) {
+    platformUnmapFile(&book->file);
+    book->count = 0;
+}
+
+static const unsigned char *entryAt(const OpeningBook *book, size_t index) {
+    return book->file.data + index * BOOK_ENTRY_SIZE;
+}
+
+uint16_t bookEncodeMove(const GameState *game, Move move) {
+    (void)game;
+    int fromX = MOVE_FROM_X(move), fromY = MOVE_FROM_Y(move);
+    int toX = MOVE_TO_X(move), toY = MOVE_TO_Y(move);
+    // Castling is stored as the king taking its own rook
+    if (MOVE_KIND(move) == MOVE_CASTLING) toX = toX == 6 ? 7 : 0;
+    // Polyglot promotions count 1 for a knight up to 4 for a queen
+    int promotion = MOVE_KIND(move) == MOVE_PROMOTION ? MOVE_PROMOTION_PIECE(move) - PAWN : 0;
+    // Polyglot rows count from white's side
+    return (uint16_t)(toX | (7 - toY) << 3 | fromX << 6 | (7 - fromY) << 9 | promotion << 12);
+}
+
+Move bookDecodeMove(const GameState *game, uint16_t encoded) {
+    int toX = encoded & 7;
+    int toY = 7 - ((encoded >> 3) & 7);
+    int fromX = (encoded >> 6) & 7;
+    int fromY = 7 - ((encoded >> 9) & 7);
+    int promotion = (encoded >> 12) & 7;
+
+    Piece piece = game->board[SQUARE(fromX, fromY)];
+    Piece target = game->board[SQUARE(toX, toY)];
+    if (PIECE_TYPE(piece) == KING && PIECE_TYPE(target) == ROOK && PIECE_COLOR(target) == PIECE_COLOR(piece)) {
+        toX = toX > fromX ? fromX + 2 : fromX - 2;
+    }
+    return moveFromSquares(game, fromX, fromY, toX, toY, promotion ? (PieceType)(PAWN + promotion) : EMPTY);
+}
+
+int bookProbe(const OpeningBook *book, const GameState *game, BookMove *moves, int maxMoves) {
+    uint64_t key = zobristKey(game);
+
+    // Lower bound: first entry whose key is not below ours
+    size_t low = 0, high = book->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (readBig(entryAt(book, mid), 8) < key) low = mid + 1;
+        else high = mid;
+    }
+
+    // isValidMove works on the board in place
+    GameState scratch = *game;
+    int count = 0;
+    for (size_t i = low; i < book->count && count < maxMoves; i++) {
+        const unsigned char *entry = entryAt(book, i);
+        if (readBig(entry, 8) != key) break;
+
+        uint16_t encoded = (uint16_t)readBig(entry + 8, 2);
+        uint16_t weight = (uint16_t)readBig(entry + 10, 2);
+        if (weight == 0) continue;
+
+        // Decoding fills in a missing promotion piece; such entries are corrupt
+        Move move = bookDecodeMove(game, encoded);
+        if (bookEncodeMove(game, move) != encoded) continue;
+        if (!isValidMove(&scratch, MOVE_FROM_X(move), MOVE_FROM_Y(move), MOVE_TO_X(move), MOVE_TO_Y(move))) continue;
+
+        moves[count].move = move;
+        moves[count].weight = weight;
+        count++;
+    }
+    return count;
+}
+
+bool bookPickMove(const OpeningBook *book, const GameState *game, uint64_t *seed, Move *move) {
+    BookMove moves[BOOK_MAX_MOVES];
+    int count = bookProbe(book, game, moves, BOOK_MAX_MOVES);
+    if (count == 0) return false;
+
+    uint32_t total = 0;
+    for (int i = 0; i < count; i++) total += moves[i].weight;
+
+    // xorshift64*, which must not start from zero
+    if (*seed == 0) *seed = 0x9E3779B97F4A7C15ull;
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    uint32_t pick = (uint32_t)((*seed * 0x2545F4914F6CDD1Dull) >> 32) % total;
+
+    for (int i = 0; i < count; i++) {
+        if (pick < moves[i].weight) {
+            *move = moves[i].move;
+            return true;
+        }
+        pick -= moves[i].weight;
+    }
+    *move = moves[count - 1].move;
+    return true;
+}
@@ -0,0 +1,64 @@
+#include "evaluate.h"
+#include "bitbase.h"
+#include "eval_weights.h"
+
+// Exact result for king and pawn versus king, scored for white
+static int evaluateKPK(const GameState *game, int whiteKing, int blackKing, int pawn, ColorPieces pawnColor) {
+    bool whiteToMove = game->currentTurn == COLOR_WHITE;
+
+    // The bitbase expects the pawn to be white
+    if (pawnColor == COLOR_BLACK) {
+        int strongKing = blackKing ^ 56;
+        blackKing = whiteKing ^ 56;
+        whiteKing = strongKing;
+        pawn ^= 56;
+        whiteToMove = !whiteToMove;
+    }
+
+    if (!kpkProbe(whiteKing, pawn, blackKing, whiteToMove)) {
+        return 0;
+    }
+
+    // Pushing the pawn is progress towards the win
+    int score = KNOWN_WIN + PAWN_VALUE + (pawn >> 3) * 10;
+    return pawnColor == COLOR_WHITE ? score : -score;
+}
+
+int evaluate(const GameState *game) {
+    int score = 0; // From white's point of view
+    int pieces = 0;
+    int pawns = 0;
+    int kings[3] = {0};
+    int pawnSquare = 0;
+    ColorPieces pawnColor = COLOR_NONE;
+
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (piece == EMPTY) continue;
+
+            // Squares as a1 = 0 ... h8 = 63 for the bitbase
+            int square = (7 - y) * 8 + x;
+            if (PIECE_TYPE(piece) == KING) {
+                kings[PIECE_COLOR(piece)] = square;
+            } else {
+                pieces++;
+                if (PIECE_TYPE(piece) == PAWN) {
+                    pawns++;
+                    pawnSquare = square;
+                    pawnColor = PIECE_COLOR(piece);
+                }
+            }
+
+            int value = evalWeights[EVAL_VALUE_INDEX(PIECE_TYPE(piece))] +
+                        evalWeights[EVAL_SQUARE_INDEX(PIECE_TYPE(piece), PIECE_COLOR(piece), x, y)];
+            score += PIECE_COLOR(piece) == COLOR_WHITE ? value : -value;
+        }
+    }
+
+    if (pieces == 1 && pawns == 1) {
+        score = evaluateKPK(game, kings[COLOR_WHITE], kings[COLOR_BLACK], pawnSquare, pawnColor);
+    }
+
+    return game->currentTurn == COLOR_WHITE ? score : -score;
+}
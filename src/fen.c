@@ -0,0 +1,141 @@
+#include "fen.h"
+#include <string.h>
+
+// FEN letters, indexed by PieceType
+static const char pieceLetters[] = " pnbrqk";
+
+// FEN letters of the castling rights, one per bit of GameState.castling
+static const char castlingLetters[] = "KQkq";
+
+// Piece for each FEN letter, EMPTY for anything else
+static const Piece pieceForChar[128] = {
+    ['P'] = PIECE(PAWN, COLOR_WHITE),   ['p'] = PIECE(PAWN, COLOR_BLACK),
+    ['N'] = PIECE(KNIGHT, COLOR_WHITE), ['n'] = PIECE(KNIGHT, COLOR_BLACK),
+    ['B'] = PIECE(BISHOP, COLOR_WHITE), ['b'] = PIECE(BISHOP, COLOR_BLACK),
+    ['R'] = PIECE(ROOK, COLOR_WHITE),   ['r'] = PIECE(ROOK, COLOR_BLACK),
+    ['Q'] = PIECE(QUEEN, COLOR_WHITE),  ['q'] = PIECE(QUEEN, COLOR_BLACK),
+    ['K'] = PIECE(KING, COLOR_WHITE),   ['k'] = PIECE(KING, COLOR_BLACK),
+};
+
+bool gameFromFEN(const char *fen, GameState *game) {
+    GameState parsed = emptyGame();
+    const unsigned char *p = (const unsigned char *)fen;
+    int kings[3] = {0, 0, 0};
+
+    // Piece placement, rank 8 first, which is row 0 of the board
+    for (int y = 0; y < 8; y++) {
+        int x = 0;
+        while (x < 8) {
+            unsigned char c = *p++;
+            if (c >= '1' && c <= '8') {
+                x += c - '0';
+                continue;
+            }
+            if (c >= 128 || pieceForChar[c] == EMPTY) return false;
+
+            Piece piece = pieceForChar[c];
+            if (PIECE_TYPE(piece) == PAWN) {
+                if (y == 0 || y == 7) return false;
+            } else if (PIECE_TYPE(piece) == KING) {
+                kings[PIECE_COLOR(piece)]++;
+                KING_SQUARE(&parsed, PIECE_COLOR(piece)) = SQUARE(x, y);
+            }
+            parsed.board[SQUARE(x, y)] = piece;
+            x++;
+        }
+        if (x != 8 || *p++ != (y < 7 ? '/' : ' ')) return false;
+    }
+    if (kings[COLOR_WHITE] != 1 || kings[COLOR_BLACK] != 1) return false;
+
+    if (*p == 'w') parsed.currentTurn = COLOR_WHITE;
+    else if (*p == 'b') parsed.currentTurn = COLOR_BLACK;
+    else return false;
+    if (*++p != ' ') return false;
+    p++;
+
+    // Castling rights need the king and rook on their home squares
+    if (*p == '-') {
+        p++;
+    } else {
+        while (*p && *p != ' ') {
+            const char *letter = strchr(castlingLetters, *p);
+            if (!letter) return false;
+            int right = (int)(letter - castlingLetters);
+            int y = right < 2 ? 7 : 0;
+            int rookX = right % 2 ? 0 : 7;
+            ColorPieces color = (y == 7) ? COLOR_WHITE : COLOR_BLACK;
+            if (parsed.board[SQUARE(4, y)] != PIECE(KING, color) ||
+                parsed.board[SQUARE(rookX, y)] != PIECE(ROOK, color)) {
+                return false;
+            }
+            parsed.castling |= 1u << right;
+            p++;
+        }
+    }
+    if (*p++ != ' ') return false;
+
+    // The en passant square must lie behind a pawn of the side that just
+    // moved, on the rank a double push skips
+    if (*p == '-') {
+        p++;
+    } else {
+        char rank = parsed.currentTurn == COLOR_WHITE ? '6' : '3';
+        if (p[0] < 'a' || p[0] > 'h' || p[1] != rank) return false;
+        int x = p[0] - 'a';
+        int y = '8' - p[1];
+        int pawnY = parsed.currentTurn == COLOR_WHITE ? y + 1 : y - 1;
+        Piece pawn = parsed.board[SQUARE(x, pawnY)];
+        if (PIECE_TYPE(pawn) != PAWN || PIECE_COLOR(pawn) == parsed.currentTurn ||
+            parsed.board[SQUARE(x, y)] != EMPTY) {
+            return false;
+        }
+        parsed.enPassant = SQUARE(x, y);
+        p += 2;
+    }
+    if (*p != '\0' && *p != ' ') return false;
+
+    parsed.isCheck = isInCheck(&parsed, parsed.currentTurn);
+    *game = parsed;
+    return true;
+}
+
+size_t gameToFEN(const GameState *game, char fen[FEN_MAX_LENGTH]) {
+    char *p = fen;
+
+    for (int y = 0; y < 8; y++) {
+        int empty = 0;
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (piece == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty) *p++ = (char)('0' + empty);
+            empty = 0;
+            char letter = pieceLetters[PIECE_TYPE(piece)];
+            *p++ = PIECE_COLOR(piece) == COLOR_WHITE ? (char)(letter - 'a' + 'A') : letter;
+        }
+        if (empty) *p++ = (char)('0' + empty);
+        *p++ = y < 7 ? '/' : ' ';
+    }
+
+    *p++ = game->currentTurn == COLOR_WHITE ? 'w' : 'b';
+    *p++ = ' ';
+
+    for (int right = 0; right < 4; right++) {
+        if (game->castling & (1u << right)) *p++ = castlingLetters[right];
+    }
+    if (!game->castling) *p++ = '-';
+    *p++ = ' ';
+
+    if (game->enPassant) {
+        *p++ = (char)('a' + SQUARE_X(game->enPassant));
+        *p++ = (char)('8' - SQUARE_Y(game->enPassant));
+    } else {
+        *p++ = '-';
+    }
+
+    // The move counters are not tracked
+    memcpy(p, " 0 1", 5);
+    return (size_t)(p + 4 - fen);
+}
@@ -3,33 +3,35 @@
 #include <math.h>
 #include <string.h>
 
+// An empty board: border squares are off the board, the rest are empty
+GameState emptyGame(void) {
+    GameState game;
+    memset(&game, 0, sizeof(game));
+    memset(game.board, OFFBOARD, sizeof(game.board));
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            game.board[SQUARE(x, y)] = EMPTY;
+        }
+    }
+    game.currentTurn = COLOR_WHITE;
+    return game;
+}
+
 // Initialize the game board
 GameState initializeGame(void) {
-    GameState game = {0};
-    game.currentTurn = COLOR_WHITE;
-    game.enPassantCol = -1;
-    game.enPassantRow = -1;
-    
-    // Set up pawns
-    for(int i = 0; i < 8; i++) {
-        game.board[1][i] = (Piece){PAWN, COLOR_BLACK, false};
-        game.board[6][i] = (Piece){PAWN, COLOR_WHITE, false};
-    }
-    
-    // Set up other pieces with hasMoved = false
-    // Black pieces
-    game.board[0][0] = game.board[0][7] = (Piece){ROOK, COLOR_BLACK, false};
-    game.board[0][1] = game.board[0][6] = (Piece){KNIGHT, COLOR_BLACK, false};
-    game.board[0][2] = game.board[0][5] = (Piece){BISHOP, COLOR_BLACK, false};
-    game.board[0][3] = (Piece){QUEEN, COLOR_BLACK, false};
-    game.board[0][4] = (Piece){KING, COLOR_BLACK, false};
-    
-    // White pieces
-    game.board[7][0] = game.board[7][7] = (Piece){ROOK, COLOR_WHITE, false};
-    game.board[7][1] = game.board[7][6] = (Piece){KNIGHT, COLOR_WHITE, false};
-    game.board[7][2] = game.board[7][5] = (Piece){BISHOP, COLOR_WHITE, false};
-    game.board[7][3] = (Piece){QUEEN, COLOR_WHITE, false};
-    game.board[7][4] = (Piece){KING, COLOR_WHITE, false};
+    static const PieceType backRank[8] = { ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK };
+    GameState game = emptyGame();
+    
+    // Set up the pieces
+    for (int x = 0; x < 8; x++) {
+        game.board[SQUARE(x, 0)] = PIECE(backRank[x], COLOR_BLACK);
+        game.board[SQUARE(x, 1)] = PIECE(PAWN, COLOR_BLACK);
+        game.board[SQUARE(x, 6)] = PIECE(PAWN, COLOR_WHITE);
+        game.board[SQUARE(x, 7)] = PIECE(backRank[x], COLOR_WHITE);
+    }
+    KING_SQUARE(&game, COLOR_WHITE) = SQUARE(4, 7);
+    KING_SQUARE(&game, COLOR_BLACK) = SQUARE(4, 0);
+    game.castling = CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG | CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG;
     
     return game;
 }
@@ -39,296 +41,252 @@ static bool isInBoard(int x, int y) {
     return x >= 0 && x < 8 && y >= 0 && y < 8;
 }
 
-static bool isPathClear(GameState* game, int fromX, int fromY, int toX, int toY) {
-    int dx = (toX - fromX) ? (toX - fromX) / abs(toX - fromX) : 0;
-    int dy = (toY - fromY) ? (toY - fromY) / abs(toY - fromY) : 0;
-    
-    int x = fromX + dx;
-    int y = fromY + dy;
+static ColorPieces opponentOf(ColorPieces color) {
+    return (color == COLOR_WHITE) ? COLOR_BLACK : COLOR_WHITE;
+}
+
+// Mailbox steps. kingSteps alternates straight and diagonal directions,
+// so a stride of 2 picks out rook or bishop rays.
+static const int knightSteps[8] = { 21, 12, -8, -19, -21, -12, 8, 19 };
+static const int kingSteps[8] = { 1, 11, 10, 9, -1, -11, -10, -9 };
+
+static bool isPathClear(GameState* game, int from, int to) {
+    int dx = SQUARE_X(to) - SQUARE_X(from);
+    int dy = SQUARE_Y(to) - SQUARE_Y(from);
+    int step = ((dx > 0) - (dx < 0)) + ((dy > 0) - (dy < 0)) * 10;
     
-    while (x != toX || y != toY) {
-        if (game->board[y][x].type != EMPTY) {
+    for (int square = from + step; square != to; square += step) {
+        if (game->board[square] != EMPTY) {
             return false;
         }
-        x += dx;
-        y += dy;
     }
     return true;
 }
 
 // Check if a move is valid for a pawn
-static bool isValidPawnMove(GameState* game, int fromX, int fromY, int toX, int toY) {
-    Piece piece = game->board[fromY][fromX];
-    int direction = (piece.color == COLOR_WHITE) ? -1 : 1;
-    int startRank = (piece.color == COLOR_WHITE) ? 6 : 1;
+static bool isValidPawnMove(GameState* game, int from, int to) {
+    Piece piece = game->board[from];
+    int forward = (PIECE_COLOR(piece) == COLOR_WHITE) ? -10 : 10;
+    int startRank = (PIECE_COLOR(piece) == COLOR_WHITE) ? 6 : 1;
     
     // Basic one square forward move
-    if (fromX == toX && toY == fromY + direction) {
-        return game->board[toY][toX].type == EMPTY;
+    if (to == from + forward) {
+        return game->board[to] == EMPTY;
     }
     
     // Initial two square move
-    if (fromX == toX && fromY == startRank && toY == fromY + 2 * direction) {
-        return game->board[toY][toX].type == EMPTY && 
-               game->board[fromY + direction][fromX].type == EMPTY;
+    if (SQUARE_Y(from) == startRank && to == from + 2 * forward) {
+        return game->board[to] == EMPTY && game->board[from + forward] == EMPTY;
     }
     
     // Diagonal capture
-    if (abs(fromX - toX) == 1 && toY == fromY + direction) {
-        if (game->board[toY][toX].type != EMPTY && game->board[toY][toX].color != piece.color) {
-            return true; // Regular diagonal capture
+    if (to == from + forward - 1 || to == from + forward + 1) {
+        if (game->board[to] != EMPTY) {
+            return PIECE_COLOR(game->board[to]) != PIECE_COLOR(piece); // Regular diagonal capture
         }
         
         // En passant check
         // For en passant, the target square is empty, but there's an enemy pawn adjacent to our pawn
-        if (game->board[toY][toX].type == EMPTY && 
-            toX == game->enPassantCol && toY == game->enPassantRow) {
-            Piece adjacentPiece = game->board[fromY][toX];
+        if (game->enPassant && to == game->enPassant) {
+            Piece adjacentPiece = game->board[to - forward];
             // Check if the adjacent piece is an enemy pawn
-            if (adjacentPiece.type == PAWN && adjacentPiece.color != piece.color) {
-                return true; // Valid en passant
-            }
+            return adjacentPiece == PIECE(PAWN, opponentOf(PIECE_COLOR(piece)));
         }
     }
     
     return false;
 }
 
-static bool isValidKnightMove(GameState* game, int fromX, int fromY, int toX, int toY) {
+static bool isValidKnightMove(GameState* game, int from, int to) {
     (void)game; // Suppress unused parameter warning
-    int dx = abs(toX - fromX);
-    int dy = abs(toY - fromY);
+    int dx = abs(SQUARE_X(to) - SQUARE_X(from));
+    int dy = abs(SQUARE_Y(to) - SQUARE_Y(from));
     return (dx == 2 && dy == 1) || (dx == 1 && dy == 2);
 }
 
-static bool isValidBishopMove(GameState* game, int fromX, int fromY, int toX, int toY) {
-    int dx = abs(toX - fromX);
-    int dy = abs(toY - fromY);
-    return dx == dy && isPathClear(game, fromX, fromY, toX, toY);
+static bool isValidBishopMove(GameState* game, int from, int to) {
+    int dx = abs(SQUARE_X(to) - SQUARE_X(from));
+    int dy = abs(SQUARE_Y(to) - SQUARE_Y(from));
+    return dx == dy && isPathClear(game, from, to);
 }
 
-static bool isValidRookMove(GameState* game, int fromX, int fromY, int toX, int toY) {
-    return ((fromX == toX || fromY == toY) && 
-            isPathClear(game, fromX, fromY, toX, toY));
+static bool isValidRookMove(GameState* game, int from, int to) {
+    return ((SQUARE_X(from) == SQUARE_X(to) || SQUARE_Y(from) == SQUARE_Y(to)) && 
+            isPathClear(game, from, to));
 }
 
-static bool isValidQueenMove(GameState* game, int fromX, int fromY, int toX, int toY) {
-    int dx = abs(toX - fromX);
-    int dy = abs(toY - fromY);
-    return ((dx == dy || fromX == toX || fromY == toY) && 
-            isPathClear(game, fromX, fromY, toX, toY));
+static bool isValidQueenMove(GameState* game, int from, int to) {
+    int dx = abs(SQUARE_X(to) - SQUARE_X(from));
+    int dy = abs(SQUARE_Y(to) - SQUARE_Y(from));
+    return ((dx == dy || dx == 0 || dy == 0) && 
+            isPathClear(game, from, to));
 }
 
-static bool isValidKingMove(GameState* game, int fromX, int fromY, int toX, int toY) {
+static bool isValidKingMove(GameState* game, int from, int to) {
     (void)game; // Suppress unused parameter warning
-    int dx = abs(toX - fromX);
-    int dy = abs(toY - fromY);
+    int dx = abs(SQUARE_X(to) - SQUARE_X(from));
+    int dy = abs(SQUARE_Y(to) - SQUARE_Y(from));
     return dx <= 1 && dy <= 1;
 }
 
-// Direct check to see if a king is attacked, without using isValidMove to avoid recursion
-static bool isKingAttacked(GameState* game, int kingX, int kingY, ColorPieces kingColor) {
-    ColorPieces opponent = (kingColor == COLOR_WHITE) ? COLOR_BLACK : COLOR_WHITE;
+// Direct check to see if a square is attacked, without using isValidMove to avoid recursion.
+// Looks outward from the square, so only the squares an attacker could stand on are read.
+// Steps off the board land on the border, which matches no piece.
+static bool isSquareAttacked(GameState* game, int square, ColorPieces opponent) {
+    // Pawns capture diagonally, so an attacking pawn stands one row nearer its own side
+    int pawnSquare = square + ((opponent == COLOR_WHITE) ? 10 : -10);
+    Piece pawn = PIECE(PAWN, opponent);
+    if (game->board[pawnSquare - 1] == pawn || game->board[pawnSquare + 1] == pawn) {
+        return true;
+    }
     
-    // Check for attacks from each opponent piece
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 8; x++) {
-            if (game->board[y][x].type != EMPTY && game->board[y][x].color == opponent) {
-                Piece piece = game->board[y][x];
-                int dx = abs(kingX - x);
-                int dy = abs(kingY - y);
-                
-                switch (piece.type) {
-                    case PAWN:
-                        // Pawns capture diagonally
-                        if (dx == 1 && ((opponent == COLOR_WHITE && y + 1 == kingY) || 
-                                       (opponent == COLOR_BLACK && y - 1 == kingY))) {
-                            return true;
-                        }
-                        break;
-                    case KNIGHT:
-                        // Knight's L-shape move
-                        if ((dx == 1 && dy == 2) || (dx == 2 && dy == 1)) {
-                            return true;
-                        }
-                        break;
-                    case BISHOP:
-                        // Bishop moves diagonally
-                        if (dx == dy && isPathClear(game, x, y, kingX, kingY)) {
-                            return true;
-                        }
-                        break;
-                    case ROOK:
-                        // Rook moves horizontally or vertically
-                        if ((x == kingX || y == kingY) && isPathClear(game, x, y, kingX, kingY)) {
-                            return true;
-                        }
-                        break;
-                    case QUEEN:
-                        // Queen combines bishop and rook moves
-                        if (((dx == dy) || (x == kingX || y == kingY)) && 
-                            isPathClear(game, x, y, kingX, kingY)) {
-                            return true;
-                        }
-                        break;
-                    case KING:
-                        // King can capture adjacent king
-                        if (dx <= 1 && dy <= 1) {
-                            return true;
-                        }
-                        break;
-                    default:
-                        break;
-                }
-            }
+    Piece knight = PIECE(KNIGHT, opponent);
+    Piece king = PIECE(KING, opponent);
+    for (int i = 0; i < 8; i++) {
+        // Knight's L-shape move
+        if (game->board[square + knightSteps[i]] == knight) {
+            return true;
+        }
+        
+        // Walk each ray to the first piece. Even steps are straight lines
+        // (rooks and queens), odd steps diagonals (bishops and queens); a
+        // king only attacks from the first square.
+        int step = kingSteps[i];
+        int target = square + step;
+        if (game->board[target] == king) {
+            return true;
+        }
+        while (game->board[target] == EMPTY) {
+            target += step;
+        }
+        Piece piece = game->board[target];
+        PieceType slider = (i % 2 == 0) ? ROOK : BISHOP;
+        if (PIECE_COLOR(piece) == opponent &&
+            (PIECE_TYPE(piece) == slider || PIECE_TYPE(piece) == QUEEN)) {
+            return true;
         }
     }
     
-    return false; // The king is not in check
+    return false; // The square is not attacked
 }
 
 // Function to check if a move would result in the king being in check
-static bool moveWouldCauseCheck(GameState* game, int fromX, int fromY, int toX, int toY) {
+static bool moveWouldCauseCheck(GameState* game, int from, int to) {
     // Save current state
-    Piece tempFromPiece = game->board[fromY][fromX];
-    Piece tempToPiece = game->board[toY][toX];
-    bool isEnPassant = false;
+    Piece tempFromPiece = game->board[from];
+    Piece tempToPiece = game->board[to];
     
-    // Check for en passant capture
-    if (tempFromPiece.type == PAWN && abs(toX - fromX) == 1 && 
-        game->board[toY][toX].type == EMPTY && 
-        toX == game->enPassantCol && toY == game->enPassantRow) {
-        isEnPassant = true;
-    }
+    // Check for en passant capture: a pawn moving diagonally onto an empty square
+    bool isEnPassant = PIECE_TYPE(tempFromPiece) == PAWN && tempToPiece == EMPTY &&
+                       SQUARE_X(to) != SQUARE_X(from);
+    int capturedSquare = SQUARE(SQUARE_X(to), SQUARE_Y(from));
     
     // Make the move temporarily
-    game->board[toY][toX] = game->board[fromY][fromX];
-    game->board[fromY][fromX].type = EMPTY;
+    game->board[to] = tempFromPiece;
+    game->board[from] = EMPTY;
     
     // If en passant, also remove the captured pawn
-    Piece capturedPawn = {EMPTY, COLOR_NONE, false};
-    int capturedY = fromY;
+    Piece capturedPawn = EMPTY;
     if (isEnPassant) {
-        capturedPawn = game->board[fromY][toX];
-        game->board[fromY][toX].type = EMPTY;
+        capturedPawn = game->board[capturedSquare];
+        game->board[capturedSquare] = EMPTY;
     }
     
-    // Find king position (might have moved!)
-    int kingX = -1, kingY = -1;
-    ColorPieces color = tempFromPiece.color;
-    
-    // If we moved the king, use the new position
-    if (tempFromPiece.type == KING) {
-        kingX = toX;
-        kingY = toY;
-    } else {
-        // Otherwise find the king
-        for (int y = 0; y < 8; y++) {
-            for (int x = 0; x < 8; x++) {
-                if (game->board[y][x].type == KING && 
-                    game->board[y][x].color == color) {
-                    kingX = x;
-                    kingY = y;
-                    break;
-                }
-            }
-            if (kingX != -1) break;
-        }
-    }
+    // The king might be the piece that moved
+    ColorPieces color = PIECE_COLOR(tempFromPiece);
+    int king = PIECE_TYPE(tempFromPiece) == KING ? to : KING_SQUARE(game, color);
     
     // Check if the king is attacked after the move
-    bool isCheck = isKingAttacked(game, kingX, kingY, color);
+    bool isCheck = isSquareAttacked(game, king, opponentOf(color));
     
     // Restore the board
-    game->board[fromY][fromX] = tempFromPiece;
-    game->board[toY][toX] = tempToPiece;
+    game->board[from] = tempFromPiece;
+    game->board[to] = tempToPiece;
     
     // Restore captured pawn if it was en passant
     if (isEnPassant) {
-        game->board[fromY][toX] = capturedPawn;
+        game->board[capturedSquare] = capturedPawn;
     }
     
     return isCheck;
 }
 
 // Add helper function for castling
-static bool canCastle(GameState* game, int fromX, int fromY, int toX, int toY) {
-    Piece piece = game->board[fromY][fromX];
+static bool canCastle(GameState* game, int from, int to) {
+    Piece piece = game->board[from];
+    ColorPieces color = PIECE_COLOR(piece);
+    int homeY = color == COLOR_WHITE ? 7 : 0;
     
-    if (piece.type != KING) return false;
-    if (piece.hasMoved) return false;
-    if (fromY != toY || abs(toX - fromX) != 2) return false;
+    if (PIECE_TYPE(piece) != KING || from != SQUARE(4, homeY)) return false;
+    if (to != from + 2 && to != from - 2) return false;
     
-    // Check if king is in check
-    if (isKingAttacked(game, fromX, fromY, piece.color)) return false;
+    bool isKingside = (to > from);
+    int right = isKingside ? CASTLE_WHITE_SHORT : CASTLE_WHITE_LONG;
+    if (color == COLOR_BLACK) right <<= 2;
+    if (!(game->castling & right)) return false;
     
-    bool isKingside = (toX > fromX);
-    int rookX = isKingside ? 7 : 0;
+    // Check if king is in check
+    if (isSquareAttacked(game, from, opponentOf(color))) return false;
     
-    Piece rook = game->board[fromY][rookX];
-    if (rook.type != ROOK || rook.hasMoved) return false;
+    int rookSquare = SQUARE(isKingside ? 7 : 0, homeY);
+    if (game->board[rookSquare] != PIECE(ROOK, color)) return false;
     
     int step = isKingside ? 1 : -1;
-    for (int x = fromX + step; x != rookX; x += step) {
-        if (game->board[fromY][x].type != EMPTY) return false;
+    for (int square = from + step; square != rookSquare; square += step) {
+        if (game->board[square] != EMPTY) return false;
     }
     
-    // Check if king passes through check
-    int midX = fromX + step;
-    if (moveWouldCauseCheck(game, fromX, fromY, midX, fromY)) return false;
+    // Check if king passes through or lands in check
+    if (moveWouldCauseCheck(game, from, from + step)) return false;
+    if (moveWouldCauseCheck(game, from, to)) return false;
     
     return true;
 }
 
-
-// Main move validation function
-bool isValidMove(GameState* game, int fromX, int fromY, int toX, int toY) {
-    if (!isInBoard(fromX, fromY) || !isInBoard(toX, toY)) {
-        return false;
-    }
-    
-    Piece piece = game->board[fromY][fromX];
+// Move validation on mailbox squares, both on the board
+static bool isLegalMove(GameState* game, int from, int to) {
+    Piece piece = game->board[from];
     
     // Can't move empty square
-    if (piece.type == EMPTY) {
+    if (piece == EMPTY) {
         return false;
     }
     
     // Can't move opponent's pieces
-    if (piece.color != game->currentTurn) {
+    if (PIECE_COLOR(piece) != game->currentTurn) {
         return false;
     }
     
     // Can't capture own pieces
-    Piece destPiece = game->board[toY][toX];
-    if (destPiece.type != EMPTY && destPiece.color == piece.color) {
+    Piece destPiece = game->board[to];
+    if (destPiece != EMPTY && PIECE_COLOR(destPiece) == PIECE_COLOR(piece)) {
         return false;
     }
     
     // Piece-specific move validation
     bool validPieceMove = false;
     
-    switch(piece.type) {
+    switch(PIECE_TYPE(piece)) {
         case PAWN:
-            validPieceMove = isValidPawnMove(game, fromX, fromY, toX, toY);
+            validPieceMove = isValidPawnMove(game, from, to);
             break;
         case KNIGHT:
-            validPieceMove = isValidKnightMove(game, fromX, fromY, toX, toY);
+            validPieceMove = isValidKnightMove(game, from, to);
             break;
         case BISHOP:
-            validPieceMove = isValidBishopMove(game, fromX, fromY, toX, toY);
+            validPieceMove = isValidBishopMove(game, from, to);
             break;
         case ROOK:
-            validPieceMove = isValidRookMove(game, fromX, fromY, toX, toY);
+            validPieceMove = isValidRookMove(game, from, to);
             break;
         case QUEEN:
-            validPieceMove = isValidQueenMove(game, fromX, fromY, toX, toY);
+            validPieceMove = isValidQueenMove(game, from, to);
             break;
         case KING:
-            if (abs(toX - fromX) == 2) {
-                return canCastle(game, fromX, fromY, toX, toY);
+            if (to == from + 2 || to == from - 2) {
+                return canCastle(game, from, to);
             } else {
-                validPieceMove = isValidKingMove(game, fromX, fromY, toX, toY);
+                validPieceMove = isValidKingMove(game, from, to);
             }
             break;
         default:
@@ -340,134 +298,130 @@ bool isValidMove(GameState* game, int fromX, int fromY, int toX, int toY) {
     }
     
     // Check if the move would leave or put the king in check
-    if (moveWouldCauseCheck(game, fromX, fromY, toX, toY)) {
+    if (moveWouldCauseCheck(game, from, to)) {
         return false;
     }
     
     return true;
 }
+
+// Main move validation function
+bool isValidMove(GameState* game, int fromX, int fromY, int toX, int toY) {
+    if (!isInBoard(fromX, fromY) || !isInBoard(toX, toY)) {
+        return false;
+    }
+    return isLegalMove(game, SQUARE(fromX, fromY), SQUARE(toX, toY));
+}
 // Function to check if a player is in check
 bool isInCheck(GameState* game, ColorPieces color) {
-    // Find king position
-    int kingX = -1, kingY = -1;
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < 8; x++) {
-            if (game->board[y][x].type == KING && 
-                game->board[y][x].color == color) {
-                kingX = x;
-                kingY = y;
-                break;
-            }
-        }
-        if (kingX != -1) break;
-    }
-    
-    if (kingX == -1) return false; // No king found
+    int king = KING_SQUARE(game, color);
+    if (king == 0) return false; // No king found
     
-    return isKingAttacked(game, kingX, kingY, color);
+    return isSquareAttacked(game, king, opponentOf(color));
+}
+
+Move moveFromSquares(const GameState* game, int fromX, int fromY, int toX, int toY, PieceType promotion) {
+    Piece piece = game->board[SQUARE(fromX, fromY)];
+    if (PIECE_TYPE(piece) == PAWN && (toY == 0 || toY == 7)) {
+        return MOVE_PROMOTING(fromX, fromY, toX, toY, promotion >= KNIGHT && promotion <= QUEEN ? promotion : QUEEN);
+    }
+    if (PIECE_TYPE(piece) == PAWN && fromX != toX && game->board[SQUARE(toX, toY)] == EMPTY) {
+        return MOVE_WITH_KIND(fromX, fromY, toX, toY, MOVE_EN_PASSANT);
+    }
+    if (PIECE_TYPE(piece) == KING && abs(toX - fromX) == 2) {
+        return MOVE_WITH_KIND(fromX, fromY, toX, toY, MOVE_CASTLING);
+    }
+    return MOVE(fromX, fromY, toX, toY);
 }
 
 // Make a move and update game state
 bool makeMove(GameState* game, Move move) {
-    if (!isValidMove(game, move.fromX, move.fromY, move.toX, move.toY)) {
+    int fromX = MOVE_FROM_X(move), fromY = MOVE_FROM_Y(move);
+    int toX = MOVE_TO_X(move), toY = MOVE_TO_Y(move);
+    if (!isValidMove(game, fromX, fromY, toX, toY)) {
         return false;
     }
-    
-    Piece piece = game->board[move.fromY][move.fromX];
-    bool isEnPassant = false;
-    
-    // Check for en passant capture
-    if (piece.type == PAWN && abs(move.toX - move.fromX) == 1 && 
-        game->board[move.toY][move.toX].type == EMPTY &&
-        move.toX == game->enPassantCol && move.toY == game->enPassantRow) {
-        isEnPassant = true;
+    // The kind must match what the move does on this board
+    if (move != moveFromSquares(game, fromX, fromY, toX, toY, MOVE_PROMOTION_PIECE(move))) {
+        return false;
     }
-    
-    // Save the old en passant state
-    int oldEnPassantCol = game->enPassantCol;
-    int oldEnPassantRow = game->enPassantRow;
+    applyMove(game, move);
+    return true;
+}
+
+// Castling rights that go when a piece moves from or to this square
+static unsigned castlingLost(int square) {
+    switch (square) {
+        case SQUARE(4, 7): return CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG;
+        case SQUARE(7, 7): return CASTLE_WHITE_SHORT;
+        case SQUARE(0, 7): return CASTLE_WHITE_LONG;
+        case SQUARE(4, 0): return CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG;
+        case SQUARE(7, 0): return CASTLE_BLACK_SHORT;
+        case SQUARE(0, 0): return CASTLE_BLACK_LONG;
+        default: return 0;
+    }
+}
+
+// Plays a move that is known to be legal, e.g. one from generateLegalMoves
+void applyMove(GameState* game, Move move) {
+    int fromX = MOVE_FROM_X(move), fromY = MOVE_FROM_Y(move);
+    int toX = MOVE_TO_X(move), toY = MOVE_TO_Y(move);
+    int from = SQUARE(fromX, fromY), to = SQUARE(toX, toY);
+    Piece piece = game->board[from];
     
     // Reset en passant flag for the next move
-    game->enPassantCol = -1;
-    game->enPassantRow = -1;
+    game->enPassant = 0;
     
     // Check for pawn moving two squares (possible en passant next move)
-    if (piece.type == PAWN && abs(move.toY - move.fromY) == 2) {
-        game->enPassantCol = move.fromX;
-        game->enPassantRow = (move.fromY + move.toY) / 2; // The square the pawn skipped over
+    if (PIECE_TYPE(piece) == PAWN && abs(toY - fromY) == 2) {
+        game->enPassant = (from + to) / 2; // The square the pawn skipped over
     }
     
-    // Handle en passant capture
-    if (isEnPassant) {
-        game->board[move.fromY][move.toX].type = EMPTY; // Remove the captured pawn
+    // Moving a king or rook, or capturing a rook, gives up castling with it
+    if (game->castling) {
+        game->castling &= ~(castlingLost(from) | castlingLost(to));
     }
-
-    // Handle castling
-    if (piece.type == KING && abs(move.toX - move.fromX) == 2) {
-        bool isKingside = (move.toX > move.fromX);
-        int rookFromX = isKingside ? 7 : 0;
-        int rookToX = isKingside ? move.toX - 1 : move.toX + 1;
-        
-        // Move rook
-        game->board[move.toY][rookToX] = game->board[move.toY][rookFromX];
-        game->board[move.toY][rookFromX].type = EMPTY;
-        game->board[move.toY][rookToX].hasMoved = true;
+    
+    switch (MOVE_KIND(move)) {
+        case MOVE_EN_PASSANT:
+            game->board[SQUARE(toX, fromY)] = EMPTY; // Remove the captured pawn
+            break;
+        case MOVE_CASTLING: {
+            bool isKingside = (toX > fromX);
+            int rookFrom = SQUARE(isKingside ? 7 : 0, toY);
+            int rookTo = isKingside ? to - 1 : to + 1;
+            
+            // Move rook
+            game->board[rookTo] = game->board[rookFrom];
+            game->board[rookFrom] = EMPTY;
+            break;
+        }
+        case MOVE_PROMOTION:
+            piece = PIECE(MOVE_PROMOTION_PIECE(move), PIECE_COLOR(piece));
+            break;
+        default:
+            break;
     }
 
     // Make the move
-    game->board[move.toY][move.toX] = game->board[move.fromY][move.fromX];
-    game->board[move.fromY][move.fromX].type = EMPTY;
-    
-    // Update hasMoved flag
-    game->board[move.toY][move.toX].hasMoved = true;
+    game->board[to] = piece;
+    game->board[from] = EMPTY;
+    if (PIECE_TYPE(piece) == KING) KING_SQUARE(game, PIECE_COLOR(piece)) = to;
 
     // Switch turns
-    game->currentTurn = (game->currentTurn == COLOR_WHITE) ? COLOR_BLACK : COLOR_WHITE;
+    game->currentTurn = opponentOf(game->currentTurn);
     
     // Check for check/checkmate on opponent
     game->isCheck = isInCheck(game, game->currentTurn);
-    
-    return true;
 }
 
-// bool isCheckmate(GameState* game) {
-//     // If not in check, it can't be checkmate
-//     if (!game->isCheck) {
-//         return false;
-//     }
-    
-    // Try every possible move for the current player
-    // for (int fromY = 0; fromY < 8; fromY++) {
-    //     for (int fromX = 0; fromX < 8; fromX++) {
-    //         // Only check pieces of current player
-    //         if (game->board[fromY][fromX].type != EMPTY && 
-    //             game->board[fromY][fromX].color == game->currentTurn) {
-                
-    //             // Try moving to every square
-    //             for (int toY = 0; toY < 8; toY++) {
-    //                 for (int toX = 0; toX < 8; toX++) {
-                        // Try the move directly with isValidMove
-                        // if (isValidMove(game, fromX, fromY, toX, toY)) {
-                        //     // If we found a valid move, it's not checkmate
-                        //     return false;
-                        // }
-                    // }
-                // }
-            // }
-        // }
-    // }
-    
-    // If no legal moves found, it's checkmate
-    // return true;
-// }
-
 void getPossibleMoves(GameState* game, int x, int y, bool moves[8][8]) {
     // Clear the moves array
     memset(moves, 0, 64 * sizeof(bool));
     
     // Check if the square contains a piece of the current player
-    if (game->board[y][x].type == EMPTY || 
-        game->board[y][x].color != game->currentTurn) {
+    Piece piece = game->board[SQUARE(x, y)];
+    if (piece == EMPTY || PIECE_COLOR(piece) != game->currentTurn) {
         return;
     }
     
@@ -482,27 +436,330 @@ void getPossibleMoves(GameState* game, int x, int y, bool moves[8][8]) {
 }
 
 bool isKingCheckmated(GameState* game) {
-    // Check if the king is in check
-    if (!isInCheck(game, game->currentTurn)) {
-        return false; // Not checkmated if the king is not in check
+    return isCheckmate(game);
+}
+
+// Checks and pins against the side to move, worked out once per position
+// so that generateLegalMoves never has to play a move to test it
+typedef struct {
+    int king;
+    int checkers;              // Pieces giving check
+    // With one checker: its square and those between it and the king
+    bool blocks[BOARD_SIZE];
+    int blockSquares[7];
+    int blockCount;
+    int8_t pins[BOARD_SIZE];   // Step from the king through each pinned piece, else 0
+} CheckInfo;
+
+// Records a checker on square to, reached from the king's side at from.
+// Only the first one's squares matter, as double check leaves only king moves.
+static void addChecker(CheckInfo* info, int from, int to, int step) {
+    if (info->checkers++) return;
+    memset(info->blocks, 0, sizeof(info->blocks));
+    info->blockCount = 0;
+    for (int square = from; ; square += step) {
+        info->blocks[square] = true;
+        info->blockSquares[info->blockCount++] = square;
+        if (square == to) break;
+    }
+}
+
+static void findChecksAndPins(GameState* game, CheckInfo* info) {
+    ColorPieces color = game->currentTurn;
+    ColorPieces opponent = opponentOf(color);
+    int king = KING_SQUARE(game, color);
+    info->king = king;
+    info->checkers = 0;
+    memset(info->pins, 0, sizeof(info->pins));
+    
+    int pawnSquare = king + ((color == COLOR_WHITE) ? -10 : 10);
+    for (int side = -1; side <= 1; side += 2) {
+        if (game->board[pawnSquare + side] == PIECE(PAWN, opponent)) {
+            addChecker(info, pawnSquare + side, pawnSquare + side, 0);
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        int square = king + knightSteps[i];
+        if (game->board[square] == PIECE(KNIGHT, opponent)) addChecker(info, square, square, 0);
+    }
+    
+    // A ray that meets an enemy slider first gives check; one that meets
+    // a single piece of ours before it pins that piece
+    for (int i = 0; i < 8; i++) {
+        int step = kingSteps[i];
+        PieceType slider = (i % 2 == 0) ? ROOK : BISHOP;
+        int pinned = 0;
+        int square = king + step;
+        for (;; square += step) {
+            Piece piece = game->board[square];
+            if (piece == EMPTY) continue;
+            if (PIECE_COLOR(piece) == color && !pinned) {
+                pinned = square;
+                continue;
+            }
+            if (PIECE_COLOR(piece) == opponent &&
+                (PIECE_TYPE(piece) == slider || PIECE_TYPE(piece) == QUEEN)) {
+                if (pinned) info->pins[pinned] = (int8_t)step;
+                else addChecker(info, king + step, square, step);
+            }
+            break;
+        }
+    }
+}
+
+// Whether a piece moving in direction step keeps to its pin ray, if any
+static bool staysOnPin(const CheckInfo* info, int from, int step) {
+    int pin = info->pins[from];
+    return pin == 0 || pin == step || pin == -step;
+}
+
+// A non-king move is legal if it deals with any check and keeps to its pin
+static bool isSafeMove(const CheckInfo* info, int from, int to, int step) {
+    return (!info->checkers || info->blocks[to]) && staysOnPin(info, from, step);
+}
+
+// En passant empties two squares, and the captured pawn is not ours, so
+// the pins miss it shielding the king along a rank or a diagonal. The
+// capture is rare enough to test by lifting both pawns, putting ours on
+// the target square and looking for attacks on the king.
+static bool enPassantExposesKing(GameState* game, int king, int from, int to, int captured) {
+    Piece pawn = game->board[from];
+    Piece capturedPawn = game->board[captured];
+    game->board[from] = EMPTY;
+    game->board[captured] = EMPTY;
+    game->board[to] = pawn;
+    bool exposed = isSquareAttacked(game, king, opponentOf(game->currentTurn));
+    game->board[to] = EMPTY;
+    game->board[captured] = capturedPawn;
+    game->board[from] = pawn;
+    return exposed;
+}
+
+// An empty square or an enemy piece, not the border or one of ours
+static bool canLandOn(Piece target, ColorPieces color) {
+    return target == EMPTY || (!IS_OFFBOARD(target) && PIECE_COLOR(target) != color);
+}
+
+// The move between two mailbox squares
+static Move squareMove(int from, int to, MoveKind kind) {
+    return MOVE_WITH_KIND(SQUARE_X(from), SQUARE_Y(from), SQUARE_X(to), SQUARE_Y(to), kind);
+}
+
+// Pawn moves to the last rank come as one move per promotion piece
+static int addPawnMove(int from, int to, Move* moves, int count) {
+    int fromX = SQUARE_X(from), fromY = SQUARE_Y(from), toX = SQUARE_X(to), toY = SQUARE_Y(to);
+    if (toY == 0 || toY == 7) {
+        moves[count++] = MOVE_PROMOTING(fromX, fromY, toX, toY, QUEEN);
+        moves[count++] = MOVE_PROMOTING(fromX, fromY, toX, toY, ROOK);
+        moves[count++] = MOVE_PROMOTING(fromX, fromY, toX, toY, BISHOP);
+        moves[count++] = MOVE_PROMOTING(fromX, fromY, toX, toY, KNIGHT);
+    } else {
+        moves[count++] = squareMove(from, to, MOVE_NORMAL);
+    }
+    return count;
+}
+
+static int addPawnMoves(GameState* game, const CheckInfo* info, int from, Move* moves, int count) {
+    ColorPieces color = game->currentTurn;
+    int forward = (color == COLOR_WHITE) ? -10 : 10;
+    int startRank = (color == COLOR_WHITE) ? 6 : 1;
+    
+    // The border is two ranks deep, so even a double push stays inside
+    int to = from + forward;
+    if (game->board[to] == EMPTY) {
+        if (isSafeMove(info, from, to, forward)) count = addPawnMove(from, to, moves, count);
+        to += forward;
+        if (SQUARE_Y(from) == startRank && game->board[to] == EMPTY && isSafeMove(info, from, to, forward)) {
+            moves[count++] = squareMove(from, to, MOVE_NORMAL);
+        }
+    }
+    
+    for (int side = -1; side <= 1; side += 2) {
+        to = from + forward + side;
+        if (game->board[to] != EMPTY && canLandOn(game->board[to], color)) {
+            if (isSafeMove(info, from, to, forward + side)) count = addPawnMove(from, to, moves, count);
+        } else if (to == game->enPassant && game->board[to - forward] == PIECE(PAWN, opponentOf(color))) {
+            // This also settles checks and pins, including a check from
+            // the pawn being captured
+            if (!enPassantExposesKing(game, info->king, from, to, to - forward)) {
+                moves[count++] = squareMove(from, to, MOVE_EN_PASSANT);
+            }
+        }
+    }
+    return count;
+}
+
+// Walks each ray until it leaves the board or hits a piece. kingSteps
+// alternates straight and diagonal directions, so a stride of 2 picks
+// out rook or bishop rays.
+static int addSlides(GameState* game, const CheckInfo* info, int from, int firstStep, int stride,
+                     Move* moves, int count) {
+    ColorPieces color = game->currentTurn;
+    for (int i = firstStep; i < 8; i += stride) {
+        int step = kingSteps[i];
+        for (int to = from + step; canLandOn(game->board[to], color); to += step) {
+            if (isSafeMove(info, from, to, step)) moves[count++] = squareMove(from, to, MOVE_NORMAL);
+            if (game->board[to] != EMPTY) break;
+        }
+    }
+    return count;
+}
+
+// In check a slider can only go to a blocking square, and along each ray
+// at most one of them is reachable, so the squares are aimed at directly
+// rather than walking every ray. Moves come out in addSlides' order.
+static int addSlideEvasions(GameState* game, const CheckInfo* info, int from, int firstStep, int stride,
+                            Move* moves, int count) {
+    int targets[8] = {0};
+    for (int j = 0; j < info->blockCount; j++) {
+        int to = info->blockSquares[j];
+        int dx = SQUARE_X(to) - SQUARE_X(from);
+        int dy = SQUARE_Y(to) - SQUARE_Y(from);
+        if (dx != 0 && dy != 0 && abs(dx) != abs(dy)) continue;
+        int step = ((dx > 0) - (dx < 0)) + ((dy > 0) - (dy < 0)) * 10;
+        for (int i = firstStep; i < 8; i += stride) {
+            if (kingSteps[i] == step && isPathClear(game, from, to)) targets[i] = to;
+        }
+    }
+    for (int i = firstStep; i < 8; i += stride) {
+        if (targets[i]) moves[count++] = squareMove(from, targets[i], MOVE_NORMAL);
+    }
+    return count;
+}
+
+// King steps are tested with the king lifted off the board, so a slider
+// checking along the step's line still covers the square behind it
+static int addKingSteps(GameState* game, int from, Move* moves, int count) {
+    ColorPieces color = game->currentTurn;
+    ColorPieces opponent = opponentOf(color);
+    Piece king = game->board[from];
+    game->board[from] = EMPTY;
+    for (int i = 0; i < 8; i++) {
+        int to = from + kingSteps[i];
+        if (!canLandOn(game->board[to], color)) continue;
+        if (!isSquareAttacked(game, to, opponent)) moves[count++] = squareMove(from, to, MOVE_NORMAL);
     }
+    game->board[from] = king;
+    return count;
+}
+
+static int addCastling(GameState* game, int from, Move* moves, int count) {
+    for (int side = 2; side >= -2; side -= 4) {
+        if (canCastle(game, from, from + side)) {
+            moves[count++] = squareMove(from, from + side, MOVE_CASTLING);
+        }
+    }
+    return count;
+}
 
-    // Check for any valid moves for the current player
+// Moves of a piece other than the king. In check only captures of the
+// checker and moves onto the squares between it and the king can help,
+// and a pinned piece can do neither, since its pin ray meets the line of
+// the check only at the king.
+static int addPieceMoves(GameState* game, const CheckInfo* info, int from, Move* moves, int count) {
+    bool inCheck = info->checkers > 0;
+    if (inCheck && info->pins[from]) return count;
+    
+    switch (PIECE_TYPE(game->board[from])) {
+        case PAWN:
+            return addPawnMoves(game, info, from, moves, count);
+        case KNIGHT:
+            // A pinned knight can never stay on its pin ray
+            if (info->pins[from]) return count;
+            for (int i = 0; i < 8; i++) {
+                int to = from + knightSteps[i];
+                if (canLandOn(game->board[to], game->currentTurn) && (!inCheck || info->blocks[to])) {
+                    moves[count++] = squareMove(from, to, MOVE_NORMAL);
+                }
+            }
+            return count;
+        case BISHOP:
+            return inCheck ? addSlideEvasions(game, info, from, 1, 2, moves, count)
+                           : addSlides(game, info, from, 1, 2, moves, count);
+        case ROOK:
+            return inCheck ? addSlideEvasions(game, info, from, 0, 2, moves, count)
+                           : addSlides(game, info, from, 0, 2, moves, count);
+        case QUEEN:
+            return inCheck ? addSlideEvasions(game, info, from, 0, 1, moves, count)
+                           : addSlides(game, info, from, 0, 1, moves, count);
+        default:
+            return count;
+    }
+}
+
+// Moves out of check: king steps and, against a single checker, the
+// evasions addPieceMoves finds. Moves come in the same order as from the
+// full generator.
+static int generateEvasions(GameState* game, const CheckInfo* info, Move* moves) {
+    // In double check only the king can move
+    if (info->checkers > 1) return addKingSteps(game, info->king, moves, 0);
+    
+    int count = 0;
     for (int y = 0; y < 8; y++) {
         for (int x = 0; x < 8; x++) {
-            Piece piece = game->board[y][x];
-            if (piece.color == game->currentTurn) {
-                // Check all possible moves for this piece
-                for (int toY = 0; toY < 8; toY++) {
-                    for (int toX = 0; toX < 8; toX++) {
-                        if (isValidMove(game, x, y, toX, toY)) {
-                            return false; // Found a valid move, not checkmated
-                        }
-                    }
-                }
+            int from = SQUARE(x, y);
+            Piece piece = game->board[from];
+            if (piece == EMPTY || PIECE_COLOR(piece) != game->currentTurn) continue;
+            if (PIECE_TYPE(piece) == KING) count = addKingSteps(game, from, moves, count);
+            else count = addPieceMoves(game, info, from, moves, count);
+        }
+    }
+    return count;
+}
+
+// Fills moves with every legal move for the side to move and returns the
+// count. Checks and pins are found first, so no move has to be played to
+// see whether it leaves the king in check.
+int generateLegalMoves(GameState* game, Move* moves) {
+    CheckInfo info;
+    findChecksAndPins(game, &info);
+    if (info.checkers) return generateEvasions(game, &info, moves);
+    
+    int count = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int from = SQUARE(x, y);
+            Piece piece = game->board[from];
+            if (piece == EMPTY || PIECE_COLOR(piece) != game->currentTurn) continue;
+            if (PIECE_TYPE(piece) == KING) {
+                count = addKingSteps(game, from, moves, count);
+                if (game->castling) count = addCastling(game, from, moves, count);
+            } else {
+                count = addPieceMoves(game, &info, from, moves, count);
             }
         }
     }
+    return count;
+}
+
+// Stops at the first legal move. The king's steps go first, as they are
+// few and cheap and usually settle it; castling needs a legal step
+// towards the rook, so it never has to be tried.
+bool hasAnyLegalMove(GameState* game) {
+    CheckInfo info;
+    findChecksAndPins(game, &info);
+    Move moves[MAX_MOVES];
+    if (addKingSteps(game, info.king, moves, 0) > 0) return true;
+    if (info.checkers > 1) return false;
+    
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int from = SQUARE(x, y);
+            Piece piece = game->board[from];
+            if (piece == EMPTY || PIECE_COLOR(piece) != game->currentTurn || PIECE_TYPE(piece) == KING) continue;
+            if (addPieceMoves(game, &info, from, moves, 0) > 0) return true;
+        }
+    }
+    return false;
+}
+
+// Both store their answer in the matching GameState flag
+bool isCheckmate(GameState* game) {
+    game->isCheckmate = isInCheck(game, game->currentTurn) && !hasAnyLegalMove(game);
+    return game->isCheckmate;
+}
 
-    return true; // No valid moves found, player is checkmated
+bool isStalemate(GameState* game) {
+    game->isStalemate = !isInCheck(game, game->currentTurn) && !hasAnyLegalMove(game);
+    return game->isStalemate;
 }
@@ -0,0 +1,86 @@
+#include "gamedb.h"
+#include "movecodec.h"
+#include <string.h>
+
+static uint64_t readLittle(const unsigned char *bytes, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+bool gameDbOpen(GameDb *db, const char *path) {
+    memset(db, 0, sizeof(*db));
+    if (!platformMapFile(path, &db->file)) return false;
+
+    const unsigned char *data = db->file.data;
+    size_t size = db->file.size;
+    if (size < GAMEDB_HEADER_SIZE || memcmp(data, GAMEDB_MAGIC, 8) != 0 ||
+        readLittle(data + 8, 4) != GAMEDB_VERSION) {
+        platformUnmapFile(&db->file);
+        return false;
+    }
+    db->gameCount = readLittle(data + 16, 8);
+    db->moveBytes = readLittle(data + 24, 8);
+    db->entryCount = readLittle(data + 32, 8);
+
+    // Game ids are 32 bits; the limits also keep the size sum from overflowing
+    if (db->gameCount > UINT32_MAX || db->moveBytes > size || db->entryCount > size ||
+        GAMEDB_HEADER_SIZE + (db->gameCount + 1) * 8 + db->gameCount + db->moveBytes +
+        db->entryCount * GAMEDB_ENTRY_SIZE != size) {
+        platformUnmapFile(&db->file);
+        return false;
+    }
+    db->offsets = data + GAMEDB_HEADER_SIZE;
+    db->results = db->offsets + (db->gameCount + 1) * 8;
+    db->moves = db->results + db->gameCount;
+    db->index = db->moves + db->moveBytes;
+    return true;
+}
+
+void gameDbClose(GameDb *db) {
+    platformUnmapFile(&db->file);
+    memset(db, 0, sizeof(*db));
+}
+
+uint64_t gameDbFind(const GameDb *db, uint64_t key, uint32_t *games, uint64_t maxGames) {
+    // Lower bound: first entry whose key is not below ours
+    uint64_t low = 0, high = db->entryCount;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (readLittle(db->index + mid * GAMEDB_ENTRY_SIZE, 8) < key) low = mid + 1;
+        else high = mid;
+    }
+
+    uint64_t count = 0;
+    for (uint64_t i = low; i < db->entryCount; i++) {
+        const unsigned char *entry = db->index + i * GAMEDB_ENTRY_SIZE;
+        if (readLittle(entry, 8) != key) break;
+        if (count < maxGames) games[count] = (uint32_t)readLittle(entry + 8, 4);
+        count++;
+    }
+    return count;
+}
+
+GameResult gameDbResult(const GameDb *db, uint32_t game) {
+    if (game >= db->gameCount || db->results[game] > RESULT_DRAW) return RESULT_NONE;
+    return (GameResult)db->results[game];
+}
+
+int gameDbMoves(const GameDb *db, uint32_t game, Move *moves, int maxMoves) {
+    if (game >= db->gameCount) return -1;
+    uint64_t first = readLittle(db->offsets + (uint64_t)game * 8, 8);
+    uint64_t last = readLittle(db->offsets + ((uint64_t)game + 1) * 8, 8);
+    if (first > last || last > db->moveBytes) return -1;
+
+    MoveDecoder decoder;
+    GameState start = initializeGame();
+    if (!moveDecoderStart(&decoder, &start, db->moves + first, (size_t)(last - first), true)) return -1;
+    int plies = decoder.pliesLeft;
+    if (plies > maxMoves) return -1;
+    for (int i = 0; i < plies; i++) {
+        if (!moveDecoderNext(&decoder, &moves[i])) return -1;
+    }
+    return plies;
+}
@@ -1,5 +1,6 @@
 #include "gui.h"
 #include "game_logic.h"
+#include "pgn_writer.h"
 #include "pieces.h"
 #include <raylib.h>
 #include <stdio.h>
@@ -53,6 +54,28 @@ void DrawSettingsMenu(bool *showSettings, Texture2D introTexture) {
     EndDrawing();
 }
 
+// Starts recording a new game from the given position
+static void startRecord(PgnRecord *record, const GameState *game) {
+    time_t now = time(NULL);
+    struct tm *date = localtime(&now);
+
+    memset(record, 0, sizeof(*record));
+    strcpy(record->white, "White");
+    strcpy(record->black, "Black");
+    if (date) strftime(record->date, sizeof(record->date), "%Y.%m.%d", date);
+    record->start = *game;
+}
+
+// Hands the game to the writer thread; nothing touches the disk here
+static void finishRecord(PgnWriter *writer, PgnRecord *record, GameResult result) {
+    if (!writer || record->plyCount == 0) return;
+    record->result = result;
+    if (!pgnWriterSubmit(writer, record)) {
+        printf("Failed to save game\n");
+    }
+    record->plyCount = 0;
+}
+
 void gameState(void) {
   // Initialize window first
   InitWindow(WIDTH, HEIGHT, "CHESS_GAME");
@@ -150,6 +173,22 @@ void gameState(void) {
   *gameState = initializeGame();
   struct ChessPieces pieces = loadChessPieces();
 
+  // Played moves, written out as PGN when the game ends
+  PgnRecord *record = malloc(sizeof(PgnRecord));
+  if (!record) {
+    printf("Failed to allocate game record memory\n");
+    free(gameState);
+    free(a);
+    CloseWindow();
+    return;
+  }
+  startRecord(record, gameState);
+  PgnWriter *pgnWriter = pgnWriterStart(PGN_EXPORT_PATH);
+  if (!pgnWriter) {
+    printf("Failed to start PGN writer, games will not be saved\n");
+  }
+  double lastMoveTime = 0.0;
+
   int width = 80;
   int height = 80;
   int posX = 0;
@@ -158,7 +197,7 @@ void gameState(void) {
   Vector2 mousePosition = {0};
   bool isDragging = false;
   int draggedX = -1, draggedY = -1;
-  Piece draggedPiece = {EMPTY, COLOR_NONE, false};
+  Piece draggedPiece = EMPTY;
   Vector2 dragOffset = {0};
 
   bool showCheckmateScreen = false;
@@ -194,6 +233,7 @@ void gameState(void) {
         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
           if (CheckCollisionPointRec(mousePosition, playButton)) {
             showIntroScreen = false; // Proceed to the game
+            lastMoveTime = GetTime();
           }
           if (CheckCollisionPointRec(mousePosition, quitButton)) {
             CloseWindow(); // Exit the game
@@ -226,8 +266,8 @@ void gameState(void) {
         int boardY = mousePosition.y / height;
         
         if (boardX >= 0 && boardX < 8 && boardY >= 0 && boardY < 8) {
-          Piece piece = gameState->board[boardY][boardX];
-          if (piece.type != EMPTY && piece.color == gameState->currentTurn) {
+          Piece piece = gameState->board[SQUARE(boardX, boardY)];
+          if (piece != EMPTY && PIECE_COLOR(piece) == gameState->currentTurn) {
             isDragging = true;
             draggedX = boardX;
             draggedY = boardY;
@@ -243,10 +283,19 @@ void gameState(void) {
         int dropY = mousePosition.y / height;
         
         if (dropX >= 0 && dropX < 8 && dropY >= 0 && dropY < 8) {
-          Move move = {draggedX, draggedY, dropX, dropY};
-          bool isCapture = gameState->board[dropY][dropX].type != EMPTY;
+          // Pawns reaching the last rank always become queens
+          Move move = moveFromSquares(gameState, draggedX, draggedY, dropX, dropY, QUEEN);
+          bool isCapture = gameState->board[SQUARE(dropX, dropY)] != EMPTY;
           
           if (makeMove(gameState, move)) {
+            double now = GetTime();
+            if (record->plyCount < PGN_MAX_PLIES) {
+              record->moves[record->plyCount] = move;
+              record->moveMs[record->plyCount] = (int)((now - lastMoveTime) * 1000.0);
+              record->plyCount++;
+            }
+            lastMoveTime = now;
+
             // Always play a sound on successful move
             if (isCapture) {
               StopSound(captureSound);  // Stop any currently playing sound
@@ -262,7 +311,7 @@ void gameState(void) {
         isDragging = false;
         draggedX = -1;
         draggedY = -1;
-        draggedPiece.type = EMPTY;
+        draggedPiece = EMPTY;
       }
 
       BeginDrawing();
@@ -280,39 +329,39 @@ void gameState(void) {
 
           // Draw pieces (except dragged piece)
           if (!(isDragging && col == draggedX && row == draggedY)) {
-            Piece piece = gameState->board[row][col];
-            if (piece.type != EMPTY) {
-              switch (piece.type) {
+            Piece piece = gameState->board[SQUARE(col, row)];
+            if (piece != EMPTY) {
+              switch (PIECE_TYPE(piece)) {
               case KING:
-                DrawTexture(piece.color == COLOR_WHITE ? pieces.whiteKing
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE ? pieces.whiteKing
                                                      : pieces.blackKing,
                           posX, posY, WHITE);
                 break;
               case QUEEN:
-                DrawTexture(piece.color == COLOR_WHITE ? pieces.whiteQueen
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE ? pieces.whiteQueen
                                                      : pieces.blackQueen,
                           posX, posY, WHITE);
                 break;
               case ROOK:
-                DrawTexture(piece.color == COLOR_WHITE
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE
                               ? pieces.whiteRook[col == 0 ? 0 : 1]
                               : pieces.blackRook[col == 0 ? 0 : 1],
                             posX, posY, WHITE);
                 break;
               case BISHOP:
-                DrawTexture(piece.color == COLOR_WHITE
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE
                               ? pieces.whiteBishop[col == 2 ? 0 : 1]
                               : pieces.blackBishop[col == 2 ? 0 : 1],
                             posX, posY, WHITE);
                 break;
               case KNIGHT:
-                DrawTexture(piece.color == COLOR_WHITE
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE
                               ? pieces.whiteKnight[col == 1 ? 0 : 1]
                               : pieces.blackKnight[col == 1 ? 0 : 1],
                             posX, posY, WHITE);
                 break;
               case PAWN:
-                DrawTexture(piece.color == COLOR_WHITE ? pieces.whitePawn[col]
+                DrawTexture(PIECE_COLOR(piece) == COLOR_WHITE ? pieces.whitePawn[col]
                                                      : pieces.blackPawn[col],
                           posX, posY, WHITE);
                 break;
@@ -329,37 +378,37 @@ void gameState(void) {
         float drawX = mousePosition.x + dragOffset.x - width/2;
         float drawY = mousePosition.y + dragOffset.y - height/2;
         
-        switch (draggedPiece.type) {
+        switch (PIECE_TYPE(draggedPiece)) {
         case KING:
-          DrawTexture(draggedPiece.color == COLOR_WHITE ? pieces.whiteKing
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE ? pieces.whiteKing
                                                        : pieces.blackKing,
                     drawX, drawY, WHITE);
           break;
         case QUEEN:
-          DrawTexture(draggedPiece.color == COLOR_WHITE ? pieces.whiteQueen
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE ? pieces.whiteQueen
                                                        : pieces.blackQueen,
                     drawX, drawY, WHITE);
           break;
         case ROOK:
-          DrawTexture(draggedPiece.color == COLOR_WHITE
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE
                         ? pieces.whiteRook[draggedX == 0 ? 0 : 1]
                         : pieces.blackRook[draggedX == 0 ? 0 : 1],
                         drawX, drawY, WHITE);
           break;
         case BISHOP:
-          DrawTexture(draggedPiece.color == COLOR_WHITE
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE
                         ? pieces.whiteBishop[draggedX == 2 ? 0 : 1]
                         : pieces.blackBishop[draggedX == 2 ? 0 : 1],
                         drawX, drawY, WHITE);
           break;
         case KNIGHT:
-          DrawTexture(draggedPiece.color == COLOR_WHITE
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE
                         ? pieces.whiteKnight[draggedX == 1 ? 0 : 1]
                         : pieces.blackKnight[draggedX == 1 ? 0 : 1],
                         drawX, drawY, WHITE);
           break;
         case PAWN:
-          DrawTexture(draggedPiece.color == COLOR_WHITE ? pieces.whitePawn[draggedX]
+          DrawTexture(PIECE_COLOR(draggedPiece) == COLOR_WHITE ? pieces.whitePawn[draggedX]
                                                        : pieces.blackPawn[draggedX],
                     drawX, drawY, WHITE);
           break;
@@ -376,11 +425,17 @@ void gameState(void) {
         showSettings = true; // Open settings menu
       }
 
-      // Check for checkmate
-      if (isKingCheckmated(gameState)) {
-        if (!showCheckmateScreen) {
+      // Check for checkmate or stalemate
+      if (!showCheckmateScreen) {
+        if (isCheckmate(gameState)) {
           showCheckmateScreen = true;
           winner = (gameState->currentTurn == COLOR_WHITE) ? COLOR_BLACK : COLOR_WHITE;
+          finishRecord(pgnWriter, record,
+                       winner == COLOR_WHITE ? RESULT_WHITE_WINS : RESULT_BLACK_WINS);
+        } else if (isStalemate(gameState)) {
+          showCheckmateScreen = true;
+          winner = COLOR_NONE;
+          finishRecord(pgnWriter, record, RESULT_DRAW);
         }
       }
 
@@ -392,8 +447,9 @@ void gameState(void) {
         Color overlayColor = ColorAlpha(BLACK, 0.7f);
         DrawRectangle(0, 0, WIDTH, HEIGHT, overlayColor);
 
-        const char* winnerText = (winner == COLOR_WHITE) ? "White Wins!" : "Black Wins!";
-        const char* checkmateText = "You have been checkmated!";
+        const char* winnerText = (winner == COLOR_NONE) ? "Draw!" :
+                                 (winner == COLOR_WHITE) ? "White Wins!" : "Black Wins!";
+        const char* checkmateText = (winner == COLOR_NONE) ? "Stalemate!" : "You have been checkmated!";
         const char* pressKeyText = "Press ENTER to restart or ESC to quit";
 
         int winnerFontSize = 60;
@@ -420,6 +476,8 @@ void gameState(void) {
 
         if (IsKeyPressed(KEY_ENTER)) {
           *gameState = initializeGame();
+          startRecord(record, gameState);
+          lastMoveTime = GetTime();
           showCheckmateScreen = false;
         }
       }
@@ -428,6 +486,12 @@ void gameState(void) {
     }
   }
 
+  // An unfinished game is saved without a result; stopping the writer
+  // waits for queued games to reach the disk
+  finishRecord(pgnWriter, record, RESULT_NONE);
+  pgnWriterStop(pgnWriter);
+  free(record);
+
   // Cleanup audio properly
   StopSound(moveSound);
   StopSound(captureSound);
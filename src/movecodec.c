@@ -0,0 +1,258 @@
+#include "movecodec.h"
+#include <string.h>
+
+#define RAW_ESCAPE 255
+
+// Range coder probabilities are 11-bit chances of a zero bit
+#define PROB_BITS 11
+#define PROB_INIT (1 << (PROB_BITS - 1))
+#define PROB_SHIFT 5
+#define RANGE_TOP (1u << 24)
+
+// Ordering weights. Changing any of them changes the format.
+static const int captureValues[] = { 0, 1, 3, 3, 5, 9, 10 };
+static const int promotionOrder[] = { 0, 0, 3, 1, 2, 4, 0 };   // Queen, knight, rook, bishop
+static const int centreWeights[] = { 0, 0, 3, 2, 1, 1, -2 };
+
+static int centre(int x, int y) {
+    return (x < 7 - x ? x : 7 - x) + (y < 7 - y ? y : 7 - y);
+}
+
+static int moveScore(const GameState *game, Move move) {
+    int fromX = MOVE_FROM_X(move), fromY = MOVE_FROM_Y(move);
+    int toX = MOVE_TO_X(move), toY = MOVE_TO_Y(move);
+    Piece piece = game->board[SQUARE(fromX, fromY)];
+    PieceType victim = MOVE_KIND(move) == MOVE_EN_PASSANT ? PAWN : PIECE_TYPE(game->board[SQUARE(toX, toY)]);
+
+    int score = 0;
+    if (MOVE_KIND(move) == MOVE_PROMOTION) score += 3000 + promotionOrder[MOVE_PROMOTION_PIECE(move)] * 100;
+    if (victim != EMPTY) return score + 2000 + captureValues[victim] * 16 - captureValues[PIECE_TYPE(piece)];
+    if (score) return score;
+    if (MOVE_KIND(move) == MOVE_CASTLING) return 1500;
+    if (PIECE_TYPE(piece) == PAWN) {
+        // Central pawns first, then double pushes
+        int file = fromX < 7 - fromX ? fromX : 7 - fromX;
+        return 1000 + file * 2 + (toY - fromY == 2 || fromY - toY == 2);
+    }
+    return 1000 + (centre(toX, toY) - centre(fromX, fromY)) * centreWeights[PIECE_TYPE(piece)];
+}
+
+// Legal moves, best first by moveScore; equal scores keep generation order
+static int orderedMoves(GameState *game, Move *list) {
+    int count = generateLegalMoves(game, list);
+    int scores[MAX_MOVES];
+    for (int i = 0; i < count; i++) {
+        Move move = list[i];
+        int score = moveScore(game, move);
+        int j = i;
+        for (; j > 0 && scores[j - 1] < score; j--) {
+            list[j] = list[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        list[j] = move;
+        scores[j] = score;
+    }
+    return count;
+}
+
+static unsigned char *writeVarint(unsigned char *out, uint32_t value) {
+    while (value >= 128) {
+        *out++ = (unsigned char)(value | 128);
+        value >>= 7;
+    }
+    *out++ = (unsigned char)value;
+    return out;
+}
+
+static bool readVarint(const unsigned char **cursor, const unsigned char *end, uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 32 && *cursor < end; shift += 7) {
+        unsigned char byte = *(*cursor)++;
+        *value |= (uint32_t)(byte & 127) << shift;
+        if (!(byte & 128)) return true;
+    }
+    return false;
+}
+
+static void initModel(MoveCodecModel *model) {
+    for (int i = 0; i < 16; i++) model->bucket[i] = PROB_INIT;
+    for (int i = 0; i < MOVE_CODEC_BUCKETS; i++) {
+        for (int j = 0; j < MOVE_CODEC_BUCKETS; j++) model->bits[i][j] = PROB_INIT;
+    }
+}
+
+// Carryless range encoder in the style of LZMA's
+typedef struct {
+    unsigned char *out;
+    uint64_t low;
+    uint32_t range;
+    unsigned char cache;
+    uint64_t cacheSize;
+} Encoder;
+
+static void shiftLow(Encoder *encoder) {
+    if ((uint32_t)encoder->low < 0xff000000u || (encoder->low >> 32) != 0) {
+        unsigned char carry = (unsigned char)(encoder->low >> 32);
+        unsigned char byte = encoder->cache;
+        do {
+            *encoder->out++ = (unsigned char)(byte + carry);
+            byte = 0xff;
+        } while (--encoder->cacheSize != 0);
+        encoder->cache = (unsigned char)(encoder->low >> 24);
+    }
+    encoder->cacheSize++;
+    encoder->low = (encoder->low & 0x00ffffffu) << 8;
+}
+
+static void encodeBit(Encoder *encoder, uint16_t *prob, int bit) {
+    uint32_t bound = (encoder->range >> PROB_BITS) * *prob;
+    if (!bit) {
+        encoder->range = bound;
+        *prob += ((1 << PROB_BITS) - *prob) >> PROB_SHIFT;
+    } else {
+        encoder->low += bound;
+        encoder->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+    }
+    while (encoder->range < RANGE_TOP) {
+        encoder->range <<= 8;
+        shiftLow(encoder);
+    }
+}
+
+static int decodeBit(MoveDecoder *decoder, uint16_t *prob) {
+    uint32_t bound = (decoder->range >> PROB_BITS) * *prob;
+    int bit;
+    if (decoder->code < bound) {
+        decoder->range = bound;
+        *prob += ((1 << PROB_BITS) - *prob) >> PROB_SHIFT;
+        bit = 0;
+    } else {
+        decoder->code -= bound;
+        decoder->range -= bound;
+        *prob -= *prob >> PROB_SHIFT;
+        bit = 1;
+    }
+    while (decoder->range < RANGE_TOP) {
+        // Past the end the stream reads as zeros
+        unsigned char byte = decoder->cursor < decoder->end ? *decoder->cursor++ : 0;
+        decoder->range <<= 8;
+        decoder->code = decoder->code << 8 | byte;
+    }
+    return bit;
+}
+
+// An index is coded as index + 1 in Exp-Golomb form: the position of its
+// top bit through a 4-bit tree, then the bits below it
+static void encodeIndex(Encoder *encoder, MoveCodecModel *model, int index) {
+    uint32_t value = (uint32_t)index + 1;
+    int bucket = 0;
+    while (value >> (bucket + 1)) bucket++;
+
+    int node = 1;
+    for (int i = 3; i >= 0; i--) {
+        int bit = (bucket >> i) & 1;
+        encodeBit(encoder, &model->bucket[node], bit);
+        node = node * 2 + bit;
+    }
+    for (int i = bucket - 1; i >= 0; i--) {
+        encodeBit(encoder, &model->bits[bucket][i], (int)(value >> i) & 1);
+    }
+}
+
+static int decodeIndex(MoveDecoder *decoder) {
+    int node = 1;
+    for (int i = 0; i < 4; i++) node = node * 2 + decodeBit(decoder, &decoder->model.bucket[node]);
+    int bucket = node - 16;
+    if (bucket >= MOVE_CODEC_BUCKETS) return -1;
+
+    uint32_t value = 1;
+    for (int i = bucket - 1; i >= 0; i--) {
+        value = value << 1 | (uint32_t)decodeBit(decoder, &decoder->model.bits[bucket][i]);
+    }
+    return (int)value - 1;
+}
+
+size_t moveCodecEncode(const GameState *start, const Move *moves, int plies, bool entropy,
+                       unsigned char *out) {
+    GameState game = *start;
+    unsigned char *p = writeVarint(out, (uint32_t)plies);
+    Encoder encoder = { p, 0, 0xffffffffu, 0, 1 };
+    MoveCodecModel model;
+    initModel(&model);
+
+    Move list[MAX_MOVES];
+    for (int ply = 0; ply < plies; ply++) {
+        int count = orderedMoves(&game, list);
+        int index = 0;
+        while (index < count && list[index] != moves[ply]) index++;
+        if (index == count) return 0;
+
+        if (entropy) {
+            encodeIndex(&encoder, &model, index);
+        } else if (index < RAW_ESCAPE) {
+            *p++ = (unsigned char)index;
+        } else {
+            *p++ = RAW_ESCAPE;
+            p = writeVarint(p, (uint32_t)(index - RAW_ESCAPE));
+        }
+        applyMove(&game, moves[ply]);
+    }
+
+    if (entropy) {
+        for (int i = 0; i < 5; i++) shiftLow(&encoder);
+        p = encoder.out;
+    }
+    return (size_t)(p - out);
+}
+
+bool moveDecoderStart(MoveDecoder *decoder, const GameState *start, const unsigned char *data,
+                      size_t length, bool entropy) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->game = *start;
+    decoder->entropy = entropy;
+    decoder->cursor = data;
+    decoder->end = data + length;
+
+    uint32_t plies;
+    if (!readVarint(&decoder->cursor, decoder->end, &plies) || plies > (uint32_t)PGN_MAX_PLIES * 64) {
+        return false;
+    }
+    decoder->pliesLeft = (int)plies;
+
+    if (entropy) {
+        initModel(&decoder->model);
+        decoder->range = 0xffffffffu;
+        // The encoder's first byte is always zero
+        for (int i = 0; i < 5; i++) {
+            unsigned char byte = decoder->cursor < decoder->end ? *decoder->cursor++ : 0;
+            decoder->code = decoder->code << 8 | byte;
+        }
+    }
+    return true;
+}
+
+bool moveDecoderNext(MoveDecoder *decoder, Move *move) {
+    if (decoder->pliesLeft <= 0) return false;
+
+    int index;
+    if (decoder->entropy) {
+        index = decodeIndex(decoder);
+    } else {
+        if (decoder->cursor == decoder->end) return false;
+        index = *decoder->cursor++;
+        uint32_t extra;
+        if (index == RAW_ESCAPE) {
+            if (!readVarint(&decoder->cursor, decoder->end, &extra) || extra > MAX_MOVES) return false;
+            index += (int)extra;
+        }
+    }
+
+    Move list[MAX_MOVES];
+    int count = orderedMoves(&decoder->game, list);
+    if (index < 0 || index >= count) return false;
+    *move = list[index];
+    applyMove(&decoder->game, *move);
+    decoder->pliesLeft--;
+    return true;
+}
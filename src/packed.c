@@ -0,0 +1,139 @@
+#include "packed.h"
+#include <stdio.h>
+#include <string.h>
+
+// Castling rights in the state byte, in FEN order like the CASTLE_* bits
+#define STATE_BLACK_TO_MOVE 1
+#define STATE_CASTLING_SHIFT 1
+
+// King and rook squares of the rights K, Q, k, q
+static const int castlingRow[4] = {7, 7, 0, 0};
+static const int castlingRookX[4] = {7, 0, 7, 0};
+
+static int clamp(int value, int low, int high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+void packPosition(const GameState *game, const PackedInfo *info, PackedPosition *packed) {
+    memset(packed, 0, sizeof(*packed));
+
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        Piece piece = game->board[SQUARE(square & 7, square >> 3)];
+        if (piece == EMPTY) continue;
+        // More than 32 pieces cannot be stored; such boards are not legal
+        if (count == 32) break;
+        packed->occupancy[square >> 3] |= (uint8_t)(1 << (square & 7));
+        int nibble = PIECE_TYPE(piece) | (PIECE_COLOR(piece) == COLOR_BLACK ? 8 : 0);
+        packed->pieces[count >> 1] |= (uint8_t)(nibble << ((count & 1) * 4));
+        count++;
+    }
+
+    if (game->currentTurn == COLOR_BLACK) packed->state |= STATE_BLACK_TO_MOVE;
+    packed->state |= (uint8_t)(game->castling << STATE_CASTLING_SHIFT);
+    if (game->enPassant) packed->enPassant = (uint8_t)(SQUARE_X(game->enPassant) + 1);
+
+    int fullmove = 1;
+    if (info) {
+        packed->halfmoveClock = (uint8_t)clamp(info->halfmoveClock, 0, 255);
+        fullmove = clamp(info->fullmove, 1, 65535);
+        int score = clamp(info->score, -32768, 32767);
+        packed->score[0] = (uint8_t)(score & 0xff);
+        packed->score[1] = (uint8_t)((score >> 8) & 0xff);
+        packed->result = (uint8_t)info->result;
+    }
+    packed->fullmove[0] = (uint8_t)(fullmove & 0xff);
+    packed->fullmove[1] = (uint8_t)(fullmove >> 8);
+}
+
+bool unpackPosition(const PackedPosition *packed, GameState *game, PackedInfo *info) {
+    GameState unpacked = emptyGame();
+    int kings[3] = {0, 0, 0};
+
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        if (!(packed->occupancy[square >> 3] & (1 << (square & 7)))) continue;
+        if (count == 32) return false;
+        int nibble = (packed->pieces[count >> 1] >> ((count & 1) * 4)) & 15;
+        count++;
+
+        PieceType type = (PieceType)(nibble & 7);
+        int y = square >> 3;
+        if (type == EMPTY || type > KING) return false;
+        Piece piece = PIECE(type, (nibble & 8) ? COLOR_BLACK : COLOR_WHITE);
+        if (type == PAWN) {
+            if (y == 0 || y == 7) return false;
+        } else if (PIECE_TYPE(piece) == KING) {
+            kings[PIECE_COLOR(piece)]++;
+            KING_SQUARE(&unpacked, PIECE_COLOR(piece)) = SQUARE(square & 7, y);
+        }
+        unpacked.board[SQUARE(square & 7, y)] = piece;
+    }
+    if (kings[COLOR_WHITE] != 1 || kings[COLOR_BLACK] != 1) return false;
+    // Unused nibbles are zero, so every position has one encoding
+    for (int i = count; i < 32; i++) {
+        if ((packed->pieces[i >> 1] >> ((i & 1) * 4)) & 15) return false;
+    }
+
+    if (packed->state >> (STATE_CASTLING_SHIFT + 4)) return false;
+    unpacked.currentTurn = (packed->state & STATE_BLACK_TO_MOVE) ? COLOR_BLACK : COLOR_WHITE;
+    for (int right = 0; right < 4; right++) {
+        if (!(packed->state & (1 << (STATE_CASTLING_SHIFT + right)))) continue;
+        int y = castlingRow[right];
+        int rookX = castlingRookX[right];
+        ColorPieces color = y == 7 ? COLOR_WHITE : COLOR_BLACK;
+        if (unpacked.board[SQUARE(4, y)] != PIECE(KING, color) ||
+            unpacked.board[SQUARE(rookX, y)] != PIECE(ROOK, color)) {
+            return false;
+        }
+        unpacked.castling |= 1u << right;
+    }
+
+    if (packed->enPassant > 8) return false;
+    if (packed->enPassant) {
+        int x = packed->enPassant - 1;
+        int y = unpacked.currentTurn == COLOR_WHITE ? 2 : 5;
+        int pawnY = unpacked.currentTurn == COLOR_WHITE ? 3 : 4;
+        Piece pawn = unpacked.board[SQUARE(x, pawnY)];
+        if (PIECE_TYPE(pawn) != PAWN || PIECE_COLOR(pawn) == unpacked.currentTurn ||
+            unpacked.board[SQUARE(x, y)] != EMPTY) {
+            return false;
+        }
+        unpacked.enPassant = SQUARE(x, y);
+    }
+
+    if (info) {
+        info->halfmoveClock = packed->halfmoveClock;
+        info->fullmove = packed->fullmove[0] | packed->fullmove[1] << 8;
+        info->score = (int16_t)(packed->score[0] | packed->score[1] << 8);
+        info->result = packed->result <= RESULT_DRAW ? (GameResult)packed->result : RESULT_NONE;
+    }
+
+    unpacked.isCheck = isInCheck(&unpacked, unpacked.currentTurn);
+    *game = unpacked;
+    return true;
+}
+
+bool packedOpen(PackedFile *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+    if (!platformMapFile(path, &file->file)) {
+        // Empty files cannot be mapped but are valid, with no positions
+        FILE *handle = fopen(path, "rb");
+        if (!handle) return false;
+        bool empty = fgetc(handle) == EOF;
+        fclose(handle);
+        return empty;
+    }
+    if (file->file.size % PACKED_POSITION_SIZE != 0) {
+        platformUnmapFile(&file->file);
+        return false;
+    }
+    file->positions = (const PackedPosition *)file->file.data;
+    file->count = file->file.size / PACKED_POSITION_SIZE;
+    return true;
+}
+
+void packedClose(PackedFile *file) {
+    if (file->positions) platformUnmapFile(&file->file);
+    memset(file, 0, sizeof(*file));
+}
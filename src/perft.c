@@ -0,0 +1,299 @@
+#include "perft.h"
+#include "platform.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The parallel tree is expanded splitDepth plies into tasks, each stored
+// as the moves leading to it. Every thread starts with an equal block of
+// tasks in its own queue and takes from the back of it. Once that is
+// empty it steals the front half of the fullest other queue, so steals
+// stay rare and neighbouring subtrees stay on one thread.
+
+typedef struct {
+    Move path[PERFT_MAX_SPLIT];
+} PerftTask;
+
+// Tasks [begin, end) of the shared task array
+typedef struct {
+    pthread_mutex_t lock;
+    int begin;
+    int end;
+} TaskQueue;
+
+typedef struct PerftJob PerftJob;
+
+typedef struct {
+    PerftJob *job;
+    pthread_t thread;
+    TaskQueue queue;
+    PerftThreadStats stats;
+} PerftWorker;
+
+struct PerftJob {
+    GameState root;
+    int splitDepth;
+    int depth; // Remaining depth below each task
+    PerftTask *tasks;
+    int taskCount;
+    int taskCapacity;
+    PerftWorker *workers;
+    int workerCount;
+    long long startMs;
+};
+
+// Subtree counts keyed by position and depth. Entries are read and
+// written without locks, like the search's transposition table: the key
+// is stored xor'ed with the data, so a torn entry fails the key check.
+// data holds the count above the low 8 bits and the depth in them.
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} PerftEntry;
+
+static PerftEntry *table;
+static size_t tableMask;  // Entry count - 1; entries are used in pairs
+
+bool perftSetHash(size_t megabytes) {
+    if (megabytes == 0) {
+        free(table);
+        table = NULL;
+        return true;
+    }
+
+    size_t entries = 2;
+    while (entries * 2 * sizeof(PerftEntry) <= megabytes << 20) entries *= 2;
+
+    PerftEntry *resized = calloc(entries, sizeof(PerftEntry));
+    if (!resized) return false;
+    free(table);
+    table = resized;
+    tableMask = entries - 1;
+    return true;
+}
+
+void perftClearHash(void) {
+    if (table) memset(table, 0, (tableMask + 1) * sizeof(PerftEntry));
+}
+
+// The same position at different depths goes to different buckets
+static uint64_t hashKey(const GameState *game, int depth) {
+    return zobristKey(game) ^ (uint64_t)depth * 0x9e3779b97f4a7c15ull;
+}
+
+static bool hashProbe(uint64_t key, unsigned long long *nodes) {
+    PerftEntry *bucket = &table[key & tableMask & ~(size_t)1];
+    for (int i = 0; i < 2; i++) {
+        uint64_t data = bucket[i].data;
+        if ((bucket[i].check ^ data) == key && data != 0) {
+            *nodes = data >> 8;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void hashStore(uint64_t key, int depth, unsigned long long nodes) {
+    uint64_t data = (uint64_t)nodes << 8 | (uint64_t)depth;
+
+    // The first slot keeps the deepest subtree, the second the newest
+    PerftEntry *bucket = &table[key & tableMask & ~(size_t)1];
+    PerftEntry *slot = depth >= (int)(bucket[0].data & 255) ? &bucket[0] : &bucket[1];
+    slot->check = key ^ data;
+    slot->data = data;
+}
+
+static unsigned long long perftNodes(GameState *game, int depth) {
+    if (depth == 0) return 1;
+
+    // The last ply is counted straight from the generator, without
+    // playing the moves
+    Move moves[MAX_MOVES];
+    int count = generateLegalMoves(game, moves);
+    if (depth == 1) return (unsigned long long)count;
+
+    uint64_t key = 0;
+    unsigned long long nodes = 0;
+    if (table) {
+        key = hashKey(game, depth);
+        if (hashProbe(key, &nodes)) return nodes;
+    }
+
+    for (int i = 0; i < count; i++) {
+        GameState next = *game;
+        applyMove(&next, moves[i]);
+        nodes += perftNodes(&next, depth - 1);
+    }
+    if (table) hashStore(key, depth, nodes);
+    return nodes;
+}
+
+unsigned long long perft(const GameState *game, int depth) {
+    GameState copy = *game;
+    return perftNodes(&copy, depth);
+}
+
+static bool collectTasks(PerftJob *job, GameState *game, Move *path, int ply) {
+    if (ply == job->splitDepth) {
+        if (job->taskCount == job->taskCapacity) {
+            int capacity = job->taskCapacity ? job->taskCapacity * 2 : 1024;
+            PerftTask *tasks = realloc(job->tasks, (size_t)capacity * sizeof(PerftTask));
+            if (!tasks) return false;
+            job->tasks = tasks;
+            job->taskCapacity = capacity;
+        }
+        memcpy(job->tasks[job->taskCount++].path, path, (size_t)ply * sizeof(Move));
+        return true;
+    }
+
+    Move moves[MAX_MOVES];
+    int count = generateLegalMoves(game, moves);
+    for (int i = 0; i < count; i++) {
+        GameState next = *game;
+        applyMove(&next, moves[i]);
+        path[ply] = moves[i];
+        if (!collectTasks(job, &next, path, ply + 1)) return false;
+    }
+    return true;
+}
+
+static bool popTask(TaskQueue *queue, int *task) {
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->begin < queue->end;
+    if (found) *task = --queue->end;
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Moves the front half of the fullest other queue into the thief's own
+// queue. Fails once every queue is empty: tasks are never added, so no
+// more work can appear.
+static bool stealTasks(PerftJob *job, PerftWorker *thief) {
+    for (;;) {
+        PerftWorker *victim = NULL;
+        int victimSize = 0;
+        for (int i = 0; i < job->workerCount; i++) {
+            PerftWorker *worker = &job->workers[i];
+            if (worker == thief) continue;
+            pthread_mutex_lock(&worker->queue.lock);
+            int size = worker->queue.end - worker->queue.begin;
+            pthread_mutex_unlock(&worker->queue.lock);
+            if (size > victimSize) {
+                victim = worker;
+                victimSize = size;
+            }
+        }
+        if (!victim) return false;
+
+        // The victim may have drained its queue since the scan
+        pthread_mutex_lock(&victim->queue.lock);
+        int size = victim->queue.end - victim->queue.begin;
+        int begin = victim->queue.begin;
+        int taken = (size + 1) / 2;
+        victim->queue.begin += taken;
+        pthread_mutex_unlock(&victim->queue.lock);
+        if (taken == 0) continue;
+
+        pthread_mutex_lock(&thief->queue.lock);
+        thief->queue.begin = begin;
+        thief->queue.end = begin + taken;
+        pthread_mutex_unlock(&thief->queue.lock);
+        thief->stats.steals++;
+        return true;
+    }
+}
+
+static void *workerMain(void *arg) {
+    PerftWorker *worker = arg;
+    PerftJob *job = worker->job;
+
+    for (;;) {
+        int task;
+        if (!popTask(&worker->queue, &task)) {
+            if (!stealTasks(job, worker)) break;
+            continue;
+        }
+
+        GameState game = job->root;
+        for (int ply = 0; ply < job->splitDepth; ply++) {
+            applyMove(&game, job->tasks[task].path[ply]);
+        }
+        worker->stats.nodes += perftNodes(&game, job->depth);
+        worker->stats.tasks++;
+    }
+    worker->stats.timeMs = platformMilliseconds() - job->startMs;
+    return NULL;
+}
+
+// Runs on the calling thread, reporting it as a single task of thread 0
+static unsigned long long perftSerial(const GameState *game, int depth, int threads,
+                                      PerftThreadStats *stats) {
+    long long start = platformMilliseconds();
+    unsigned long long nodes = perft(game, depth);
+    if (stats) {
+        memset(stats, 0, (size_t)threads * sizeof(PerftThreadStats));
+        stats[0].nodes = nodes;
+        stats[0].tasks = 1;
+        stats[0].timeMs = platformMilliseconds() - start;
+    }
+    return nodes;
+}
+
+unsigned long long perftParallel(const GameState *game, int depth, int splitDepth,
+                                 int threads, PerftThreadStats *stats) {
+    if (threads < 1) threads = 1;
+    if (threads > PERFT_MAX_THREADS) threads = PERFT_MAX_THREADS;
+    if (splitDepth > PERFT_MAX_SPLIT) splitDepth = PERFT_MAX_SPLIT;
+    if (splitDepth > depth - 1) splitDepth = depth - 1;
+    if (splitDepth < 1 || threads == 1) return perftSerial(game, depth, threads, stats);
+
+    PerftJob job;
+    memset(&job, 0, sizeof(job));
+    job.root = *game;
+    job.splitDepth = splitDepth;
+    job.depth = depth - splitDepth;
+    job.startMs = platformMilliseconds();
+
+    GameState root = *game;
+    Move path[PERFT_MAX_SPLIT];
+    job.workers = calloc((size_t)threads, sizeof(PerftWorker));
+    if (!job.workers || !collectTasks(&job, &root, path, 0)) {
+        free(job.workers);
+        free(job.tasks);
+        return perftSerial(game, depth, threads, stats);
+    }
+
+    job.workerCount = threads;
+    for (int i = 0; i < threads; i++) {
+        PerftWorker *worker = &job.workers[i];
+        worker->job = &job;
+        pthread_mutex_init(&worker->queue.lock, NULL);
+        worker->queue.begin = (int)((long long)job.taskCount * i / threads);
+        worker->queue.end = (int)((long long)job.taskCount * (i + 1) / threads);
+    }
+
+    // Tasks queued for threads that fail to start are stolen by the others
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&job.workers[i].thread, NULL, workerMain, &job.workers[i]) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        workerMain(&job.workers[0]);
+    } else {
+        for (int i = 0; i < started; i++) {
+            pthread_join(job.workers[i].thread, NULL);
+        }
+    }
+
+    unsigned long long nodes = 0;
+    for (int i = 0; i < threads; i++) {
+        nodes += job.workers[i].stats.nodes;
+        if (stats) stats[i] = job.workers[i].stats;
+        pthread_mutex_destroy(&job.workers[i].queue.lock);
+    }
+    free(job.workers);
+    free(job.tasks);
+    return nodes;
+}
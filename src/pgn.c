@@ -0,0 +1,357 @@
+#include "pgn.h"
+#include "fen.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool pgnOpen(PgnReader *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+    if (!platformMapFile(path, &reader->file)) {
+        // Empty files cannot be mapped but are valid, with no games
+        FILE *file = fopen(path, "rb");
+        if (!file) return false;
+        bool empty = fgetc(file) == EOF;
+        fclose(file);
+        return empty;
+    }
+    reader->ownsFile = true;
+    reader->cursor = (const char *)reader->file.data;
+    reader->end = reader->cursor + reader->file.size;
+    return true;
+}
+
+void pgnClose(PgnReader *reader) {
+    if (reader->ownsFile) platformUnmapFile(&reader->file);
+    memset(reader, 0, sizeof(*reader));
+}
+
+static const char *lineEnd(const char *p, const char *end) {
+    const char *newline = memchr(p, '\n', (size_t)(end - p));
+    return newline ? newline : end;
+}
+
+static const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+// First tag line at or after p that follows something other than a tag,
+// which is where a game starts
+static const char *nextGameStart(const char *begin, const char *p, const char *end) {
+    // Back up to the start of the line
+    while (p > begin && p[-1] != '\n') p--;
+
+    bool afterTag = false;
+    if (p > begin) {
+        const char *previous = p - 1;
+        while (previous > begin && previous[-1] != '\n') previous--;
+        afterTag = *skipBlanks(previous, p) == '[';
+    }
+
+    while (p < end) {
+        const char *text = skipBlanks(p, end);
+        bool isTag = text < end && *text == '[';
+        if (isTag && !afterTag) return p;
+        afterTag = isTag;
+        p = lineEnd(p, end);
+        if (p < end) p++;
+    }
+    return end;
+}
+
+void pgnSplit(const PgnReader *reader, int index, int count, PgnReader *chunk) {
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->file = reader->file;
+    size_t size = (size_t)(reader->end - reader->cursor);
+    const char *begin = reader->cursor;
+    chunk->cursor = index == 0 ? begin :
+        nextGameStart(begin, begin + (size_t)((double)size * index / count), reader->end);
+    chunk->end = index + 1 >= count ? reader->end :
+        nextGameStart(begin, begin + (size_t)((double)size * (index + 1) / count), reader->end);
+    if (chunk->cursor > chunk->end) chunk->cursor = chunk->end;
+}
+
+static bool startsWith(const char *text, const char *end, const char *prefix) {
+    size_t length = strlen(prefix);
+    return (size_t)(end - text) >= length && memcmp(text, prefix, length) == 0;
+}
+
+static GameResult parseResult(const char *text, const char *end) {
+    if (startsWith(text, end, "1-0")) return RESULT_WHITE_WINS;
+    if (startsWith(text, end, "0-1")) return RESULT_BLACK_WINS;
+    if (startsWith(text, end, "1/2-1/2")) return RESULT_DRAW;
+    return RESULT_NONE;
+}
+
+static void parseTag(const char *line, const char *end, PgnGame *game) {
+    const char *value = memchr(line, '"', (size_t)(end - line));
+    if (!value) return;
+    value++;
+    if (startsWith(line, end, "[Result ")) {
+        game->result = parseResult(value, end);
+    } else if (startsWith(line, end, "[FEN ")) {
+        game->hasSetup = true;
+    }
+}
+
+bool pgnReadGame(PgnReader *reader, PgnGame *game) {
+    memset(game, 0, sizeof(*game));
+    const char *p = reader->cursor;
+    const char *end = reader->end;
+    bool inMovetext = false;
+    bool found = false;
+
+    while (p < end) {
+        const char *stop = lineEnd(p, end);
+        const char *next = stop < end ? stop + 1 : end;
+        const char *text = skipBlanks(p, stop);
+        if (text == stop || *text == '%') {
+            p = next;
+            continue;
+        }
+
+        if (*text == '[') {
+            // A tag after movetext starts the next game
+            if (inMovetext) break;
+            if (!game->tags) game->tags = p;
+            game->tagsLength = (size_t)(next - game->tags);
+            parseTag(text, stop, game);
+        } else {
+            if (!inMovetext) game->movetext = p;
+            inMovetext = true;
+            game->movetextLength = (size_t)(stop - game->movetext);
+        }
+        found = true;
+        p = next;
+    }
+
+    reader->cursor = p;
+    return found;
+}
+
+bool pgnTag(const PgnGame *game, const char *name, const char **value, size_t *length) {
+    const char *p = game->tags;
+    const char *end = game->tags + game->tagsLength;
+    size_t nameLength = strlen(name);
+
+    while (p < end) {
+        const char *stop = lineEnd(p, end);
+        const char *text = skipBlanks(p, stop);
+        if (text < stop && *text == '[' && (size_t)(stop - text) > nameLength + 1 &&
+            memcmp(text + 1, name, nameLength) == 0 && text[nameLength + 1] == ' ') {
+            const char *open = memchr(text, '"', (size_t)(stop - text));
+            if (!open) return false;
+            const char *close = open + 1;
+            while (close < stop && *close != '"') close += *close == '\\' ? 2 : 1;
+            if (close >= stop) return false;
+            *value = open + 1;
+            *length = (size_t)(close - open - 1);
+            return true;
+        }
+        p = stop < end ? stop + 1 : end;
+    }
+    return false;
+}
+
+bool pgnNextSan(const char **cursor, const char *end, const char **san, size_t *length) {
+    const char *p = *cursor;
+    int depth = 0;  // Nesting level of variations
+
+    while (p < end) {
+        char c = *p;
+        if (isspace((unsigned char)c)) {
+            p++;
+        } else if (c == '{') {
+            while (p < end && *p != '}') p++;
+            if (p < end) p++;
+        } else if (c == ';' || c == '%') {
+            while (p < end && *p != '\n') p++;
+        } else if (c == '(') {
+            depth++;
+            p++;
+        } else if (c == ')') {
+            if (depth > 0) depth--;
+            p++;
+        } else {
+            const char *start = p;
+            while (p < end && !isspace((unsigned char)*p) && *p != '{' && *p != '(' &&
+                   *p != ')' && *p != ';') {
+                p++;
+            }
+            if (depth > 0 || *start == '$') continue;
+            if (*start == '*' || parseResult(start, p) != RESULT_NONE) {
+                // Nothing after the result belongs to the game
+                *cursor = end;
+                return false;
+            }
+            if (isdigit((unsigned char)*start)) {
+                // Move number ("12." or "12..."), possibly glued to the move
+                const char *q = start;
+                while (q < p && isdigit((unsigned char)*q)) q++;
+                if (q == p || *q == '.') {
+                    while (q < p && *q == '.') q++;
+                    if (q == p) continue;
+                    start = q;
+                }
+            }
+            *san = start;
+            *length = (size_t)(p - start);
+            *cursor = p;
+            return true;
+        }
+    }
+    *cursor = end;
+    return false;
+}
+
+static PieceType pieceFromLetter(char letter) {
+    switch (letter) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default: return EMPTY;
+    }
+}
+
+bool sanToMove(GameState *game, const char *san, size_t length, Move *move) {
+    // Drop check marks and annotations
+    while (length > 0 && strchr("+#!?", san[length - 1])) length--;
+    if (length < 2) return false;
+
+    int homeY = game->currentTurn == COLOR_WHITE ? 7 : 0;
+    if (san[0] == 'O' || san[0] == '0') {
+        int toX = length >= 5 ? 2 : 6;
+        if (!isValidMove(game, 4, homeY, toX, homeY)) return false;
+        *move = MOVE_WITH_KIND(4, homeY, toX, homeY, MOVE_CASTLING);
+        return true;
+    }
+
+    PieceType type = pieceFromLetter(san[0]);
+    size_t pos = 0;
+    if (type == EMPTY) type = PAWN;
+    else pos = 1;
+
+    // Promotions ("e8=Q", "e8Q") end with a piece letter
+    PieceType promoted = pieceFromLetter(san[length - 1]);
+    if (promoted != EMPTY) {
+        if (type != PAWN || promoted == KING) return false;
+        length--;
+        if (length > 0 && san[length - 1] == '=') length--;
+    }
+    if (length < pos + 2) return false;
+
+    int toX = san[length - 2] - 'a';
+    int toY = '8' - san[length - 1];
+    if (toX < 0 || toX > 7 || toY < 0 || toY > 7) return false;
+    if (type == PAWN && (toY == 0 || toY == 7) && promoted == EMPTY) return false;
+    if (promoted != EMPTY && toY != 7 - homeY) return false;
+
+    // Optional disambiguation between the piece and the destination
+    int fromX = -1, fromY = -1;
+    for (size_t i = pos; i < length - 2; i++) {
+        char c = san[i];
+        if (c >= 'a' && c <= 'h') fromX = c - 'a';
+        else if (c >= '1' && c <= '8') fromY = '8' - c;
+        else if (c != 'x' && c != '-' && c != ':') return false;
+    }
+
+    int found = 0;
+    for (int y = 0; y < 8; y++) {
+        if (fromY >= 0 && y != fromY) continue;
+        for (int x = 0; x < 8; x++) {
+            if (fromX >= 0 && x != fromX) continue;
+            Piece piece = game->board[SQUARE(x, y)];
+            if (PIECE_TYPE(piece) != type || PIECE_COLOR(piece) != game->currentTurn) continue;
+            // Pawns without a file given can only push straight ahead
+            if (type == PAWN && fromX < 0 && x != toX) continue;
+            if (!isValidMove(game, x, y, toX, toY)) continue;
+            *move = moveFromSquares(game, x, y, toX, toY, promoted);
+            found++;
+        }
+    }
+    return found == 1;
+}
+
+size_t moveToSan(GameState *game, Move move, char san[PGN_MAX_SAN]) {
+    static const char letters[] = "  NBRQK";
+    int fromX = MOVE_FROM_X(move), fromY = MOVE_FROM_Y(move);
+    int toX = MOVE_TO_X(move), toY = MOVE_TO_Y(move);
+    Piece piece = game->board[SQUARE(fromX, fromY)];
+    char *p = san;
+
+    if (MOVE_KIND(move) == MOVE_CASTLING) {
+        const char *castle = toX > fromX ? "O-O" : "O-O-O";
+        memcpy(p, castle, strlen(castle));
+        p += strlen(castle);
+    } else {
+        bool isCapture = game->board[SQUARE(toX, toY)] != EMPTY || MOVE_KIND(move) == MOVE_EN_PASSANT;
+        if (PIECE_TYPE(piece) == PAWN) {
+            if (isCapture) *p++ = (char)('a' + fromX);
+        } else {
+            *p++ = letters[PIECE_TYPE(piece)];
+
+            // Name the file if that tells the pieces apart, else the rank,
+            // else both
+            Move moves[MAX_MOVES];
+            int count = generateLegalMoves(game, moves);
+            bool ambiguous = false, sameFile = false, sameRank = false;
+            for (int i = 0; i < count; i++) {
+                Move other = moves[i];
+                if (MOVE_TO(other) != MOVE_TO(move) || MOVE_FROM(other) == MOVE_FROM(move)) continue;
+                if (PIECE_TYPE(game->board[MOVE_FROM_SQUARE(other)]) != PIECE_TYPE(piece)) continue;
+                ambiguous = true;
+                if (MOVE_FROM_X(other) == fromX) sameFile = true;
+                if (MOVE_FROM_Y(other) == fromY) sameRank = true;
+            }
+            if (ambiguous && (!sameFile || sameRank)) *p++ = (char)('a' + fromX);
+            if (ambiguous && sameFile) *p++ = (char)('8' - fromY);
+        }
+        if (isCapture) *p++ = 'x';
+        *p++ = (char)('a' + toX);
+        *p++ = (char)('8' - toY);
+        if (MOVE_KIND(move) == MOVE_PROMOTION) {
+            *p++ = '=';
+            *p++ = letters[MOVE_PROMOTION_PIECE(move)];
+        }
+    }
+
+    GameState next = *game;
+    applyMove(&next, move);
+    if (next.isCheck) {
+        Move replies[MAX_MOVES];
+        *p++ = generateLegalMoves(&next, replies) > 0 ? '+' : '#';
+    }
+    *p = '\0';
+    return (size_t)(p - san);
+}
+
+int pgnDecodeGame(const PgnGame *pgn, GameState *game, Move *moves, int maxMoves) {
+    if (pgn->hasSetup) {
+        // gameFromFEN needs a terminated string; the tag value is not
+        char fen[128];
+        const char *value;
+        size_t length;
+        if (!pgnTag(pgn, "FEN", &value, &length) || length >= sizeof(fen)) return -1;
+        memcpy(fen, value, length);
+        fen[length] = '\0';
+        if (!gameFromFEN(fen, game)) return -1;
+    } else {
+        *game = initializeGame();
+    }
+
+    const char *cursor = pgn->movetext;
+    const char *end = pgn->movetext + pgn->movetextLength;
+    const char *san;
+    size_t length;
+    int count = 0;
+    while (pgnNextSan(&cursor, end, &san, &length)) {
+        Move move;
+        if (count == maxMoves || !sanToMove(game, san, length, &move)) return -1;
+        moves[count++] = move;
+        applyMove(game, move);
+    }
+    return count;
+}
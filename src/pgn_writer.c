@@ -0,0 +1,185 @@
+#include "pgn_writer.h"
+#include "fen.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_LENGTH 79
+
+typedef struct QueuedGame {
+    struct QueuedGame *next;
+    PgnRecord record;
+} QueuedGame;
+
+struct PgnWriter {
+    char *path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    QueuedGame *head;
+    QueuedGame *tail;
+    bool stopping;
+};
+
+static const char *resultText(GameResult result) {
+    switch (result) {
+        case RESULT_WHITE_WINS: return "1-0";
+        case RESULT_BLACK_WINS: return "0-1";
+        case RESULT_DRAW: return "1/2-1/2";
+        default: return "*";
+    }
+}
+
+// Movetext is wrapped so that no line is longer than LINE_LENGTH
+typedef struct {
+    FILE *file;
+    int column;
+} Wrapper;
+
+static void writeToken(Wrapper *out, const char *token) {
+    int length = (int)strlen(token);
+    if (out->column > 0 && out->column + 1 + length > LINE_LENGTH) {
+        fputc('\n', out->file);
+        out->column = 0;
+    }
+    if (out->column > 0) {
+        fputc(' ', out->file);
+        out->column++;
+    }
+    fputs(token, out->file);
+    out->column += length;
+}
+
+bool pgnWriteGame(FILE *file, const PgnRecord *record) {
+    const char *result = resultText(record->result);
+    fprintf(file, "[Event \"Casual game\"]\n");
+    fprintf(file, "[Site \"?\"]\n");
+    fprintf(file, "[Date \"%s\"]\n", record->date[0] ? record->date : "????.??.??");
+    fprintf(file, "[Round \"-\"]\n");
+    fprintf(file, "[White \"%s\"]\n", record->white[0] ? record->white : "?");
+    fprintf(file, "[Black \"%s\"]\n", record->black[0] ? record->black : "?");
+    fprintf(file, "[Result \"%s\"]\n", result);
+
+    char fen[FEN_MAX_LENGTH];
+    gameToFEN(&record->start, fen);
+    if (strcmp(fen, FEN_START) != 0) {
+        fprintf(file, "[SetUp \"1\"]\n");
+        fprintf(file, "[FEN \"%s\"]\n", fen);
+    }
+    fputc('\n', file);
+
+    Wrapper out = { file, 0 };
+    GameState game = record->start;
+    int moveNumber = 1;
+    bool needNumber = true;  // Black moves are numbered after a comment
+    char token[32];
+    for (int i = 0; i < record->plyCount; i++) {
+        Move move = record->moves[i];
+
+        if (game.currentTurn == COLOR_WHITE) {
+            sprintf(token, "%d.", moveNumber);
+            writeToken(&out, token);
+        } else if (needNumber) {
+            sprintf(token, "%d...", moveNumber);
+            writeToken(&out, token);
+        }
+
+        char san[PGN_MAX_SAN];
+        moveToSan(&game, move, san);
+        writeToken(&out, san);
+        needNumber = false;
+
+        int ms = record->moveMs[i];
+        if (ms >= 0) {
+            int seconds = ms / 1000;
+            sprintf(token, "{[%%emt %d:%02d:%02d]}", seconds / 3600, seconds / 60 % 60, seconds % 60);
+            writeToken(&out, token);
+            needNumber = true;
+        }
+
+        if (game.currentTurn == COLOR_BLACK) moveNumber++;
+        applyMove(&game, move);
+    }
+    writeToken(&out, result);
+    fputs("\n\n", file);
+    return !ferror(file);
+}
+
+static void writeQueued(const char *path, const PgnRecord *record) {
+    FILE *file = fopen(path, "a");
+    bool ok = file && pgnWriteGame(file, record);
+    if (file && fclose(file) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Cannot write game to %s\n", path);
+}
+
+static void *writerMain(void *arg) {
+    PgnWriter *writer = arg;
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->head && !writer->stopping) {
+            pthread_cond_wait(&writer->wake, &writer->lock);
+        }
+        QueuedGame *queued = writer->head;
+        if (!queued) break;
+        writer->head = queued->next;
+        if (!writer->head) writer->tail = NULL;
+
+        pthread_mutex_unlock(&writer->lock);
+        writeQueued(writer->path, &queued->record);
+        free(queued);
+        pthread_mutex_lock(&writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+PgnWriter *pgnWriterStart(const char *path) {
+    PgnWriter *writer = calloc(1, sizeof(PgnWriter));
+    if (!writer) return NULL;
+    writer->path = malloc(strlen(path) + 1);
+    if (!writer->path) {
+        free(writer);
+        return NULL;
+    }
+    strcpy(writer->path, path);
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->wake, NULL);
+    if (pthread_create(&writer->thread, NULL, writerMain, writer) != 0) {
+        pthread_cond_destroy(&writer->wake);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer->path);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+bool pgnWriterSubmit(PgnWriter *writer, const PgnRecord *record) {
+    QueuedGame *queued = malloc(sizeof(QueuedGame));
+    if (!queued) return false;
+    queued->next = NULL;
+    queued->record = *record;
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->tail) writer->tail->next = queued;
+    else writer->head = queued;
+    writer->tail = queued;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+    return true;
+}
+
+void pgnWriterStop(PgnWriter *writer) {
+    if (!writer) return;
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->wake);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    pthread_cond_destroy(&writer->wake);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->path);
+    free(writer);
+}
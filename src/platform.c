@@ -0,0 +1,259 @@
+#include "platform.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+int platformCpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
+
+long long platformMilliseconds(void) {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+#endif
+}
+
+bool platformMapFile(const char *path, MappedFile *file) {
+    memset(file, 0, sizeof(*file));
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file->data = data;
+    file->size = (size_t)size.QuadPart;
+    file->fileHandle = handle;
+    file->mapHandle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    file->data = data;
+    file->size = (size_t)info.st_size;
+#endif
+    return true;
+}
+
+void platformUnmapFile(MappedFile *file) {
+    if (!file->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapHandle);
+    CloseHandle(file->fileHandle);
+#else
+    munmap((void *)file->data, file->size);
+#endif
+    memset(file, 0, sizeof(*file));
+}
+
+bool platformSpawn(const char *command, ChildProcess *child) {
+    memset(child, 0, sizeof(*child));
+
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES security = { sizeof(security), NULL, TRUE };
+    HANDLE childIn, toChild, fromChild, childOut;
+    if (!CreatePipe(&childIn, &toChild, &security, 0)) return false;
+    if (!CreatePipe(&fromChild, &childOut, &security, 0)) {
+        CloseHandle(childIn);
+        CloseHandle(toChild);
+        return false;
+    }
+    // Our ends must not be inherited
+    SetHandleInformation(toChild, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(fromChild, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA startup;
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = childIn;
+    startup.hStdOutput = childOut;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    char commandLine[4096];
+    snprintf(commandLine, sizeof(commandLine), "cmd.exe /c %s", command);
+    PROCESS_INFORMATION info;
+    BOOL created = CreateProcessA(NULL, commandLine, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info);
+    CloseHandle(childIn);
+    CloseHandle(childOut);
+    if (!created) {
+        CloseHandle(toChild);
+        CloseHandle(fromChild);
+        return false;
+    }
+    CloseHandle(info.hThread);
+
+    child->input = _fdopen(_open_osfhandle((intptr_t)toChild, _O_WRONLY), "w");
+    child->output = _fdopen(_open_osfhandle((intptr_t)fromChild, _O_RDONLY), "r");
+    child->handle = info.hProcess;
+    child->pid = (long)info.dwProcessId;
+#else
+    int toChild[2], fromChild[2];
+    if (pipe(toChild) != 0) return false;
+    if (pipe(fromChild) != 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+        return false;
+    }
+    if (pid == 0) {
+        // Own process group, so that a kill also reaches whatever the
+        // shell started
+        setpgid(0, 0);
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+    // Also set here, in case the child has not got that far yet
+    setpgid(pid, pid);
+    close(toChild[0]);
+    close(fromChild[1]);
+    // Children spawned later must not hold on to this child's pipes
+    fcntl(toChild[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fromChild[0], F_SETFD, FD_CLOEXEC);
+    // Writing to an engine that died must not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    child->input = fdopen(toChild[1], "w");
+    child->output = fdopen(fromChild[0], "r");
+    child->pid = (long)pid;
+#endif
+    if (!child->input || !child->output) {
+        platformCloseProcess(child);
+        return false;
+    }
+    setvbuf(child->input, NULL, _IOLBF, 4096);
+    // Unbuffered so that waiting on the pipe sees every byte not read yet
+    setvbuf(child->output, NULL, _IONBF, 0);
+    return true;
+}
+
+// Waits until the child's output can be read without blocking
+static bool waitReadable(ChildProcess *child, long long deadline) {
+#ifdef _WIN32
+    HANDLE pipe = (HANDLE)_get_osfhandle(_fileno(child->output));
+    for (;;) {
+        DWORD available = 0;
+        // A failed peek means the pipe is closed; let the read report it
+        if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL) || available > 0) return true;
+        if (platformMilliseconds() >= deadline) return false;
+        Sleep(1);
+    }
+#else
+    struct pollfd poller = { fileno(child->output), POLLIN, 0 };
+    for (;;) {
+        long long remaining = deadline - platformMilliseconds();
+        if (remaining < 0) remaining = 0;
+        int ready = poll(&poller, 1, (int)remaining);
+        if (ready > 0) return true;
+        if (ready == 0) return false;
+        if (errno != EINTR) return true;
+    }
+#endif
+}
+
+PlatformReadResult platformReadLine(ChildProcess *child, char *line, size_t size, int timeoutMs) {
+    long long deadline = platformMilliseconds() + timeoutMs;
+    size_t length = 0;
+    for (;;) {
+        if (!waitReadable(child, deadline)) return PLATFORM_READ_TIMEOUT;
+        int c = fgetc(child->output);
+        if (c == EOF) return PLATFORM_READ_CLOSED;
+        if (c == '\n') break;
+        if (c != '\r' && length + 1 < size) line[length++] = (char)c;
+    }
+    line[length] = '\0';
+    return PLATFORM_READ_LINE;
+}
+
+void platformCloseProcess(ChildProcess *child) {
+    if (child->input) fclose(child->input);
+    if (child->output) fclose(child->output);
+#ifdef _WIN32
+    if (child->handle) {
+        WaitForSingleObject(child->handle, INFINITE);
+        CloseHandle(child->handle);
+    }
+#else
+    if (child->pid > 0) waitpid((pid_t)child->pid, NULL, 0);
+#endif
+    memset(child, 0, sizeof(*child));
+}
+
+void platformKillProcess(ChildProcess *child) {
+#ifdef _WIN32
+    if (child->handle) TerminateProcess(child->handle, 1);
+#else
+    if (child->pid > 0) kill(-(pid_t)child->pid, SIGKILL);
+#endif
+    platformCloseProcess(child);
+}
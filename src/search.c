@@ -0,0 +1,628 @@
+#include "search.h"
+#include "evaluate.h"
+#include "platform.h"
+#include "tbprobe.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keys of earlier game positions kept for repetition detection
+#define HISTORY_MAX 1024
+
+// Tablebase wins rank below any mate found by the search itself
+#define SCORE_TB_WIN (2 * KNOWN_WIN)
+
+// Transposition table. Entries are read and written without locks: the
+// key is stored xor'ed with the data, so an entry torn by two threads
+// writing at once fails the key check instead of returning garbage.
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TtEntry;
+
+enum { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+static TtEntry *table;
+static size_t tableMask;  // Entry count - 1; entries are used in pairs
+static unsigned generation;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    GameState root;
+    long long nodes;
+    uint64_t keys[HISTORY_MAX + SEARCH_MAX_PLY + 1];
+    int keyCount;
+    Move killers[SEARCH_MAX_PLY + 1][2];
+    int history[64][64];
+    Move pv[SEARCH_MAX_PLY + 1][SEARCH_MAX_PLY + 1];
+    int pvLength[SEARCH_MAX_PLY + 1];
+    int maxDepth;
+
+    // Last completed iteration
+    int completedDepth;
+    SearchInfo result;
+
+    // searchLocal threads keep their own limits and never touch control
+    bool local;
+    bool localStop;
+    long long nodeLimit;
+} SearchThread;
+
+// State shared by all search threads. stop and pondering are polled
+// without the lock inside the search; writes always take it.
+static pthread_mutex_t controlLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t controlChanged = PTHREAD_COND_INITIALIZER;
+
+static struct {
+    volatile bool stop;
+    volatile bool pondering;
+    bool infinite;
+    bool running;
+    long long start;
+    long long softLimit;  // ms; not started on another iteration past this
+    long long hardLimit;  // ms; the search is cut off here
+    long long nodeLimit;
+    int threadCount;
+    SearchThread *threads;
+    pthread_t mainThread;
+    SearchInfoCallback callback;
+    void *context;
+    Move fallback;  // Played when nothing better is known
+} control;
+
+bool searchSetHash(size_t megabytes) {
+    size_t entries = 2;
+    while (entries * 2 * sizeof(TtEntry) <= megabytes << 20) entries *= 2;
+
+    TtEntry *resized = calloc(entries, sizeof(TtEntry));
+    if (!resized) return false;
+    free(table);
+    table = resized;
+    tableMask = entries - 1;
+    return true;
+}
+
+void searchClearHash(void) {
+    if (table) memset(table, 0, (tableMask + 1) * sizeof(TtEntry));
+}
+
+// Mate scores are stored relative to the node, not the root
+static int scoreToTable(int score, int ply) {
+    if (score > SCORE_MATE_BOUND) return score + ply;
+    if (score < -SCORE_MATE_BOUND) return score - ply;
+    return score;
+}
+
+static int scoreFromTable(int score, int ply) {
+    if (score > SCORE_MATE_BOUND) return score - ply;
+    if (score < -SCORE_MATE_BOUND) return score + ply;
+    return score;
+}
+
+static bool ttProbe(uint64_t key, uint64_t *data) {
+    TtEntry *bucket = &table[key & tableMask & ~(size_t)1];
+    for (int i = 0; i < 2; i++) {
+        uint64_t entryData = bucket[i].data;
+        if ((bucket[i].check ^ entryData) == key && entryData != 0) {
+            *data = entryData;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ttStore(uint64_t key, Move move, int score, int depth, int bound) {
+    uint64_t data = (uint64_t)move |
+                    (uint64_t)(uint16_t)(score + 32768) << 16 |
+                    (uint64_t)(depth & 255) << 32 |
+                    (uint64_t)bound << 40 |
+                    (uint64_t)(generation & 255) << 48;
+
+    // The first slot keeps the deepest result, the second the newest
+    TtEntry *bucket = &table[key & tableMask & ~(size_t)1];
+    uint64_t old = bucket[0].data;
+    bool sameKey = (bucket[0].check ^ old) == key;
+    if (old == 0 || sameKey || ((old >> 48) & 255) != (generation & 255) ||
+        depth >= (int)((old >> 32) & 255)) {
+        bucket[0].check = key ^ data;
+        bucket[0].data = data;
+    } else {
+        bucket[1].check = key ^ data;
+        bucket[1].data = data;
+    }
+}
+
+static bool isCapture(const GameState *game, Move move) {
+    return game->board[MOVE_TO_SQUARE(move)] != EMPTY || MOVE_KIND(move) == MOVE_EN_PASSANT;
+}
+
+// Captures and queen promotions; underpromotions are left to the main search
+static bool isTactical(const GameState *game, Move move) {
+    return isCapture(game, move) || MOVE_PROMOTION_PIECE(move) == QUEEN;
+}
+
+// Legal moves; tacticalOnly keeps just the tactical ones.
+// *legal receives the count before filtering.
+static int generateMoves(GameState *game, Move *moves, bool tacticalOnly, int *legal) {
+    int count = generateLegalMoves(game, moves);
+    *legal = count;
+    if (!tacticalOnly) return count;
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (isTactical(game, moves[i])) moves[kept++] = moves[i];
+    }
+    return kept;
+}
+
+static const int orderValues[] = { 0, 1, 3, 3, 5, 9, 10 };
+
+static void scoreMoves(const SearchThread *t, const GameState *game, const Move *moves, int count,
+                       int *scores, Move ttMove, int ply) {
+    for (int i = 0; i < count; i++) {
+        Move move = moves[i];
+        if (move == ttMove) {
+            scores[i] = 1 << 30;
+        } else if (isTactical(game, move)) {
+            // Most valuable victim, least valuable attacker; a promotion
+            // counts its new piece as won
+            PieceType victim = PIECE_TYPE(game->board[MOVE_TO_SQUARE(move)]);
+            int victimValue = MOVE_KIND(move) == MOVE_EN_PASSANT ? orderValues[PAWN] : orderValues[victim];
+            victimValue += orderValues[MOVE_PROMOTION_PIECE(move)];
+            scores[i] = (1 << 24) + victimValue * 16 -
+                        orderValues[PIECE_TYPE(game->board[MOVE_FROM_SQUARE(move)])];
+        } else if (move == t->killers[ply][0]) {
+            scores[i] = (1 << 23) + 1;
+        } else if (move == t->killers[ply][1]) {
+            scores[i] = 1 << 23;
+        } else {
+            scores[i] = t->history[MOVE_FROM(move)][MOVE_TO(move)];
+        }
+    }
+}
+
+// Moves the best remaining move to position index
+static void pickMove(Move *moves, int *scores, int count, int index) {
+    int best = index;
+    for (int i = index + 1; i < count; i++) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    Move move = moves[best];
+    moves[best] = moves[index];
+    moves[index] = move;
+    int score = scores[best];
+    scores[best] = scores[index];
+    scores[index] = score;
+}
+
+// Only the main thread watches the clock and the node budget
+static void checkLimits(SearchThread *t) {
+    if (t->local) {
+        if (t->nodeLimit > 0 && t->nodes >= t->nodeLimit) t->localStop = true;
+        return;
+    }
+    if (t->id != 0 || control.stop) return;
+    bool expired = control.hardLimit > 0 && !control.pondering &&
+                   platformMilliseconds() - control.start >= control.hardLimit;
+    bool spent = control.nodeLimit > 0 && t->nodes * control.threadCount >= control.nodeLimit;
+    if (expired || spent) {
+        pthread_mutex_lock(&controlLock);
+        control.stop = true;
+        pthread_cond_broadcast(&controlChanged);
+        pthread_mutex_unlock(&controlLock);
+    }
+}
+
+// The first iteration always completes so there is a move to play
+static bool stopped(const SearchThread *t) {
+    return (t->local ? t->localStop : control.stop) && t->completedDepth > 0;
+}
+
+// Node budgets of local searches are small, so they are checked exactly
+static void countNode(SearchThread *t) {
+    if ((++t->nodes & 1023) == 0 || t->local) checkLimits(t);
+}
+
+// Same position with the same side to move earlier in the game or line
+static bool isRepetition(const SearchThread *t, uint64_t key) {
+    for (int i = t->keyCount - 2; i >= 0; i -= 2) {
+        if (t->keys[i] == key) return true;
+    }
+    return false;
+}
+
+static bool probeTablebase(GameState *game, int ply, int *score) {
+    int maxPieces = tbProbePieces();
+    if (maxPieces == 0) return false;
+
+    int pieces = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            if (game->board[SQUARE(x, y)] != EMPTY && ++pieces > maxPieces) return false;
+        }
+    }
+
+    TbWdl wdl;
+    if (!tbProbeWDL(game, &wdl)) return false;
+    *score = wdl == TB_WIN ? SCORE_TB_WIN - ply : wdl == TB_LOSS ? -SCORE_TB_WIN + ply : 0;
+    return true;
+}
+
+static void updatePv(SearchThread *t, int ply, Move move) {
+    t->pv[ply][0] = move;
+    int length = t->pvLength[ply + 1];
+    memcpy(&t->pv[ply][1], t->pv[ply + 1], (size_t)length * sizeof(Move));
+    t->pvLength[ply] = length + 1;
+}
+
+static int quiescence(SearchThread *t, GameState *game, int alpha, int beta, int ply) {
+    t->pvLength[ply] = 0;
+    countNode(t);
+    if (stopped(t)) return 0;
+    if (ply >= SEARCH_MAX_PLY) return evaluate(game);
+
+    // Out of check, the side to move may stand pat instead of capturing
+    bool inCheck = game->isCheck;
+    int best = -SCORE_INFINITE;
+    if (!inCheck) {
+        best = evaluate(game);
+        if (best >= beta) return best;
+        if (best > alpha) alpha = best;
+    }
+
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES];
+    int legal;
+    int count = generateMoves(game, moves, !inCheck, &legal);
+    if (legal == 0) return inCheck ? -SCORE_MATE + ply : 0;
+    scoreMoves(t, game, moves, count, scores, MOVE_NONE, ply);
+
+    for (int i = 0; i < count; i++) {
+        pickMove(moves, scores, count, i);
+        GameState child = *game;
+        applyMove(&child, moves[i]);
+        int score = -quiescence(t, &child, -beta, -alpha, ply + 1);
+        if (stopped(t)) return 0;
+
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(t, ply, moves[i]);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+    return best;
+}
+
+static bool hasPieces(const GameState *game) {
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (PIECE_COLOR(piece) == game->currentTurn && PIECE_TYPE(piece) >= KNIGHT && PIECE_TYPE(piece) <= QUEEN) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int alphaBeta(SearchThread *t, GameState *game, int depth, int alpha, int beta,
+                     int ply, bool allowNull) {
+    if (depth <= 0) return quiescence(t, game, alpha, beta, ply);
+
+    t->pvLength[ply] = 0;
+    countNode(t);
+    if (stopped(t)) return 0;
+
+    uint64_t key = zobristKey(game);
+    bool isPv = beta - alpha > 1;
+    if (ply > 0) {
+        if (isRepetition(t, key)) return 0;
+
+        // No line from here can beat a mate already found closer to the root
+        if (alpha < -SCORE_MATE + ply) alpha = -SCORE_MATE + ply;
+        if (beta > SCORE_MATE - ply - 1) beta = SCORE_MATE - ply - 1;
+        if (alpha >= beta) return alpha;
+
+        int tbScore;
+        if (probeTablebase(game, ply, &tbScore)) return tbScore;
+    }
+    if (ply >= SEARCH_MAX_PLY) return evaluate(game);
+
+    Move ttMove = MOVE_NONE;
+    uint64_t data;
+    if (ttProbe(key, &data)) {
+        ttMove = (Move)data;
+        int ttScore = scoreFromTable((int)((data >> 16) & 0xffff) - 32768, ply);
+        int ttDepth = (int)((data >> 32) & 255);
+        int bound = (int)((data >> 40) & 3);
+        if (!isPv && ply > 0 && ttDepth >= depth &&
+            (bound == BOUND_EXACT || (bound == BOUND_LOWER && ttScore >= beta) ||
+             (bound == BOUND_UPPER && ttScore <= alpha))) {
+            return ttScore;
+        }
+    }
+
+    bool inCheck = game->isCheck;
+    if (inCheck) depth++;
+
+    t->keys[t->keyCount++] = key;
+
+    // Null move: if passing still fails high, a real move will too
+    if (allowNull && !isPv && !inCheck && depth >= 3 && beta < SCORE_MATE_BOUND && hasPieces(game)) {
+        GameState child = *game;
+        child.currentTurn = game->currentTurn == COLOR_WHITE ? COLOR_BLACK : COLOR_WHITE;
+        child.enPassant = 0;
+        int score = -alphaBeta(t, &child, depth - 3, -beta, -beta + 1, ply + 1, false);
+        if (stopped(t)) {
+            t->keyCount--;
+            return 0;
+        }
+        if (score >= beta) {
+            t->keyCount--;
+            return score >= SCORE_MATE_BOUND ? beta : score;
+        }
+    }
+
+    Move moves[MAX_MOVES];
+    int scores[MAX_MOVES];
+    int legal;
+    int count = generateMoves(game, moves, false, &legal);
+    if (count == 0) {
+        t->keyCount--;
+        return inCheck ? -SCORE_MATE + ply : 0;
+    }
+    scoreMoves(t, game, moves, count, scores, ttMove, ply);
+
+    int originalAlpha = alpha;
+    int best = -SCORE_INFINITE;
+    Move bestMove = moves[0];
+    for (int i = 0; i < count; i++) {
+        pickMove(moves, scores, count, i);
+        Move move = moves[i];
+        bool quiet = !isTactical(game, move);
+        GameState child = *game;
+        applyMove(&child, move);
+
+        int score;
+        if (i == 0) {
+            score = -alphaBeta(t, &child, depth - 1, -beta, -alpha, ply + 1, true);
+        } else {
+            // Late quiet moves are searched shallower first
+            int reduction = (depth >= 3 && i >= 4 && quiet && !inCheck && !child.isCheck) ? 1 : 0;
+            score = -alphaBeta(t, &child, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+            if (score > alpha && (reduction || score < beta)) {
+                score = -alphaBeta(t, &child, depth - 1, -beta, -alpha, ply + 1, true);
+            }
+        }
+        if (stopped(t)) {
+            t->keyCount--;
+            return 0;
+        }
+
+        if (score > best) {
+            best = score;
+            bestMove = move;
+            if (score > alpha) {
+                alpha = score;
+                updatePv(t, ply, move);
+                if (alpha >= beta) {
+                    if (quiet) {
+                        if (move != t->killers[ply][0]) {
+                            t->killers[ply][1] = t->killers[ply][0];
+                            t->killers[ply][0] = move;
+                        }
+                        int *history = &t->history[MOVE_FROM(move)][MOVE_TO(move)];
+                        *history += depth * depth;
+                        if (*history > (1 << 22)) *history = 1 << 22;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    t->keyCount--;
+
+    int bound = best >= beta ? BOUND_LOWER : best > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+    ttStore(key, bestMove, scoreToTable(best, ply), depth, bound);
+    return best;
+}
+
+static long long totalNodes(void) {
+    // Other threads' counters are read while they run; close enough for reporting
+    long long nodes = 0;
+    for (int i = 0; i < control.threadCount; i++) nodes += control.threads[i].nodes;
+    return nodes;
+}
+
+static void iterate(SearchThread *t) {
+    // Helpers start staggered so threads spread over different depths
+    for (int depth = 1 + (t->id & 1); depth <= t->maxDepth; depth++) {
+        GameState game = t->root;
+        int score = alphaBeta(t, &game, depth, -SCORE_INFINITE, SCORE_INFINITE, 0, false);
+        if (stopped(t)) break;
+
+        t->completedDepth = depth;
+        t->result.depth = depth;
+        t->result.score = score;
+        t->result.pvLength = t->pvLength[0];
+        memcpy(t->result.pv, t->pv[0], (size_t)t->pvLength[0] * sizeof(Move));
+        if (t->id != 0 || t->local) continue;
+
+        long long elapsed = platformMilliseconds() - control.start;
+        if (control.callback) {
+            t->result.nodes = totalNodes();
+            t->result.timeMs = elapsed;
+            control.callback(&t->result, control.context);
+        }
+        // Another iteration would likely not finish in time
+        if (control.softLimit > 0 && !control.pondering && elapsed >= control.softLimit) break;
+    }
+}
+
+static void *helperMain(void *arg) {
+    iterate(arg);
+    return NULL;
+}
+
+static void *mainSearch(void *arg) {
+    SearchThread *t = arg;
+    int started = 1;
+    for (; started < control.threadCount; started++) {
+        SearchThread *helper = &control.threads[started];
+        if (pthread_create(&helper->thread, NULL, helperMain, helper) != 0) break;
+    }
+
+    iterate(t);
+
+    // Infinite and ponder searches report only once told to
+    pthread_mutex_lock(&controlLock);
+    while (!control.stop && (control.infinite || control.pondering)) {
+        pthread_cond_wait(&controlChanged, &controlLock);
+    }
+    control.stop = true;
+    pthread_mutex_unlock(&controlLock);
+
+    for (int i = 1; i < started; i++) pthread_join(control.threads[i].thread, NULL);
+    return NULL;
+}
+
+static void initThread(SearchThread *t, int id, const GameState *root, const uint64_t *history,
+                       int historyLength, int depth) {
+    if (historyLength > HISTORY_MAX) {
+        history += historyLength - HISTORY_MAX;
+        historyLength = HISTORY_MAX;
+    }
+    t->id = id;
+    t->root = *root;
+    t->maxDepth = depth > 0 && depth < SEARCH_MAX_PLY ? depth : SEARCH_MAX_PLY;
+    memcpy(t->keys, history, (size_t)historyLength * sizeof(uint64_t));
+    t->keyCount = historyLength;
+    for (int ply = 0; ply <= SEARCH_MAX_PLY; ply++) {
+        t->killers[ply][0] = t->killers[ply][1] = MOVE_NONE;
+    }
+}
+
+bool searchStart(const GameState *game, const uint64_t *history, int historyLength,
+                 const SearchLimits *limits, int threads,
+                 SearchInfoCallback callback, void *context) {
+    if (control.running) return false;
+    if (!table && !searchSetHash(SEARCH_DEFAULT_HASH_MB)) return false;
+    if (threads < 1) threads = 1;
+    if (threads > SEARCH_MAX_THREADS) threads = SEARCH_MAX_THREADS;
+
+    GameState root = *game;
+    Move moves[MAX_MOVES];
+    int legal;
+    if (generateMoves(&root, moves, false, &legal) == 0) return false;
+
+    SearchThread *workers = calloc((size_t)threads, sizeof(SearchThread));
+    if (!workers) return false;
+
+    for (int i = 0; i < threads; i++) {
+        initThread(&workers[i], i, &root, history, historyLength, limits->depth);
+    }
+
+    // Time budget for this move: a share of the clock plus most of the
+    // increment, with a hard cap well inside the remaining time
+    int side = game->currentTurn == COLOR_WHITE ? 0 : 1;
+    long long soft = 0, hard = 0;
+    if (limits->moveTime > 0) {
+        soft = hard = limits->moveTime;
+    } else if (limits->time[side] > 0) {
+        long long left = limits->time[side];
+        int movesToGo = limits->movesToGo > 0 ? limits->movesToGo : 30;
+        soft = left / movesToGo + limits->increment[side] * 3 / 4;
+        hard = soft * 4 < left / 2 ? soft * 4 : left / 2;
+        if (soft > hard) soft = hard;
+        if (hard < 1) soft = hard = 1;
+    }
+
+    pthread_mutex_lock(&controlLock);
+    control.stop = false;
+    control.pondering = limits->ponder;
+    control.infinite = limits->infinite;
+    control.start = platformMilliseconds();
+    control.softLimit = soft;
+    control.hardLimit = hard;
+    control.nodeLimit = limits->nodes;
+    control.threadCount = threads;
+    control.threads = workers;
+    control.callback = callback;
+    control.context = context;
+    control.fallback = moves[0];
+    pthread_mutex_unlock(&controlLock);
+
+    generation++;
+    if (pthread_create(&control.mainThread, NULL, mainSearch, &workers[0]) != 0) {
+        free(workers);
+        control.threads = NULL;
+        return false;
+    }
+    control.running = true;
+    return true;
+}
+
+bool searchWait(Move *best, Move *ponder) {
+    if (!control.running) return false;
+    pthread_join(control.mainThread, NULL);
+
+    const SearchInfo *result = &control.threads[0].result;
+    *best = result->pvLength > 0 ? result->pv[0] : control.fallback;
+    if (ponder) {
+        *ponder = result->pvLength > 1 ? result->pv[1] : MOVE_NONE;
+    }
+
+    free(control.threads);
+    control.threads = NULL;
+    control.running = false;
+    return true;
+}
+
+bool searchRun(const GameState *game, const uint64_t *history, int historyLength,
+               const SearchLimits *limits, int threads,
+               SearchInfoCallback callback, void *context, Move *best, Move *ponder) {
+    return searchStart(game, history, historyLength, limits, threads, callback, context) &&
+           searchWait(best, ponder);
+}
+
+void searchStop(void) {
+    pthread_mutex_lock(&controlLock);
+    control.stop = true;
+    pthread_cond_broadcast(&controlChanged);
+    pthread_mutex_unlock(&controlLock);
+}
+
+void searchPonderHit(void) {
+    pthread_mutex_lock(&controlLock);
+    // The clock for this move starts now
+    control.start = platformMilliseconds();
+    control.pondering = false;
+    pthread_cond_broadcast(&controlChanged);
+    pthread_mutex_unlock(&controlLock);
+}
+
+bool searchLocal(const GameState *game, const uint64_t *history, int historyLength,
+                 const SearchLimits *limits, Move *best, int *score) {
+    if (!table) return false;
+
+    GameState root = *game;
+    Move moves[MAX_MOVES];
+    int legal;
+    if (generateMoves(&root, moves, false, &legal) == 0) return false;
+
+    SearchThread *t = calloc(1, sizeof(SearchThread));
+    if (!t) return false;
+    initThread(t, 0, &root, history, historyLength, limits->depth);
+    t->local = true;
+    t->nodeLimit = limits->nodes;
+    iterate(t);
+
+    *best = t->result.pvLength > 0 ? t->result.pv[0] : moves[0];
+    if (score) *score = t->result.score;
+    free(t);
+    return true;
+}
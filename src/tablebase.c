@@ -0,0 +1,1174 @@
+#include "tablebase.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Work is handed out to the worker threads in chunks of this many entries
+#define CHUNK_SIZE (1u << 16)
+#define MAX_GEN_MOVES 128
+#define MAX_SUB_TABLES 8
+#define MAX_DISTANCE (TB_ILLEGAL - 2)
+
+static const char pieceLetters[] = "?PNBRQK";
+
+static const int kingSteps[8][2] = {
+    {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+};
+static const int knightJumps[8][2] = {
+    {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}
+};
+// Rook directions first, then bishop directions
+static const int rays[8][2] = {
+    {1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}
+};
+
+// ---------------------------------------------------------------------------
+// Indexing
+// ---------------------------------------------------------------------------
+
+static int kingPairIndex[64][64];
+static uint8_t kingPairTransform[64][64];
+static uint8_t pairWhiteKing[TB_KING_PAIRS];
+static uint8_t pairBlackKing[TB_KING_PAIRS];
+static pthread_once_t kingPairsOnce = PTHREAD_ONCE_INIT;
+
+// Applies one of the 8 board symmetries: bit 0 mirrors files, bit 1
+// mirrors ranks and bit 2 reflects in the a1-h8 diagonal
+static int transformSquare(int square, int transform) {
+    int file = square & 7;
+    int rank = square >> 3;
+    if (transform & 1) file = 7 - file;
+    if (transform & 2) rank = 7 - rank;
+    if (transform & 4) {
+        int tmp = file;
+        file = rank;
+        rank = tmp;
+    }
+    return TB_SQUARE(file, rank);
+}
+
+static bool kingsTouch(int a, int b) {
+    return abs((a & 7) - (b & 7)) <= 1 && abs((a >> 3) - (b >> 3)) <= 1;
+}
+
+// White king in the a1-d1-d4 triangle; on the diagonal the black king
+// must be on or below it as well
+static bool isCanonicalPair(int whiteKing, int blackKing) {
+    int file = whiteKing & 7;
+    int rank = whiteKing >> 3;
+    if (file > 3 || rank > file) return false;
+    if (rank == file) return (blackKing >> 3) <= (blackKing & 7);
+    return true;
+}
+
+static void initKingPairs(void) {
+    static int canonical[64][64];
+    int count = 0;
+
+    for (int wk = 0; wk < 64; wk++) {
+        for (int bk = 0; bk < 64; bk++) {
+            canonical[wk][bk] = -1;
+            if (!kingsTouch(wk, bk) && isCanonicalPair(wk, bk)) {
+                pairWhiteKing[count] = (uint8_t)wk;
+                pairBlackKing[count] = (uint8_t)bk;
+                canonical[wk][bk] = count++;
+            }
+        }
+    }
+
+    for (int wk = 0; wk < 64; wk++) {
+        for (int bk = 0; bk < 64; bk++) {
+            kingPairIndex[wk][bk] = -1;
+            kingPairTransform[wk][bk] = 0;
+            if (kingsTouch(wk, bk)) continue;
+            for (int t = 0; t < 8; t++) {
+                int tw = transformSquare(wk, t);
+                int tb = transformSquare(bk, t);
+                if (canonical[tw][tb] >= 0) {
+                    kingPairIndex[wk][bk] = canonical[tw][tb];
+                    kingPairTransform[wk][bk] = (uint8_t)t;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+uint32_t tbEntriesPerSide(int pieceCount) {
+    uint32_t entries = TB_KING_PAIRS;
+    for (int i = 2; i < pieceCount; i++) {
+        entries *= 64;
+    }
+    return entries;
+}
+
+// Index of a piece list already in table order
+static bool encodeSquares(const TbPieceList *pieces, int blackKingSlot, uint32_t *index) {
+    int wk = pieces->square[0];
+    int bk = pieces->square[blackKingSlot];
+    int pair = kingPairIndex[wk][bk];
+    if (pair < 0) return false;
+
+    // With both kings on the a1-h8 diagonal the reflection in it keeps them
+    // in place, so the first piece off the diagonal decides
+    int transform = kingPairTransform[wk][bk];
+    int twk = transformSquare(wk, transform);
+    int tbk = transformSquare(bk, transform);
+    if ((twk >> 3) == (twk & 7) && (tbk >> 3) == (tbk & 7)) {
+        for (int i = 1; i < pieces->count; i++) {
+            if (i == blackKingSlot) continue;
+            int square = transformSquare(pieces->square[i], transform);
+            if ((square >> 3) == (square & 7)) continue;
+            if ((square >> 3) > (square & 7)) transform ^= 4;
+            break;
+        }
+    }
+
+    uint32_t result = (uint32_t)pair;
+    for (int i = 1; i < pieces->count; i++) {
+        if (i == blackKingSlot) continue;
+        result = result * 64 + (uint32_t)transformSquare(pieces->square[i], transform);
+    }
+    *index = result;
+    return true;
+}
+
+static void decodeSquares(TbPieceList *pieces, int blackKingSlot, uint32_t index) {
+    for (int i = pieces->count - 1; i >= 1; i--) {
+        if (i == blackKingSlot) continue;
+        pieces->square[i] = (int)(index % 64);
+        index /= 64;
+    }
+    pieces->square[0] = pairWhiteKing[index];
+    pieces->square[blackKingSlot] = pairBlackKing[index];
+}
+
+static int pieceValue(PieceType type) {
+    switch (type) {
+        case PAWN: return 1;
+        case KNIGHT: return 3;
+        case BISHOP: return 3;
+        case ROOK: return 5;
+        case QUEEN: return 9;
+        default: return 0;
+    }
+}
+
+// Positive if side a has more material than side b
+static int compareMaterial(const int a[KING + 1], const int b[KING + 1]) {
+    int valueA = 0, valueB = 0, countA = 0, countB = 0;
+    for (int type = PAWN; type < KING; type++) {
+        valueA += a[type] * pieceValue((PieceType)type);
+        valueB += b[type] * pieceValue((PieceType)type);
+        countA += a[type];
+        countB += b[type];
+    }
+    if (valueA != valueB) return valueA - valueB;
+    if (countA != countB) return countA - countB;
+    for (int type = QUEEN; type >= PAWN; type--) {
+        if (a[type] != b[type]) return a[type] - b[type];
+    }
+    return 0;
+}
+
+// Sorts pieces into table order, swapping colours (and mirroring ranks)
+// when black is the stronger side. Returns the table side to move.
+static int orderPieces(const TbPieceList *in, ColorPieces sideToMove, TbPieceList *out, char name[16]) {
+    int counts[3][KING + 1] = {{0}};
+    for (int i = 0; i < in->count; i++) {
+        counts[in->color[i]][in->type[i]]++;
+    }
+    bool flip = compareMaterial(counts[COLOR_WHITE], counts[COLOR_BLACK]) < 0;
+    ColorPieces strong = flip ? COLOR_BLACK : COLOR_WHITE;
+    ColorPieces weak = flip ? COLOR_WHITE : COLOR_BLACK;
+
+    int length = 0;
+    out->count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        ColorPieces from = pass == 0 ? strong : weak;
+        for (int type = KING; type >= PAWN; type--) {
+            for (int i = 0; i < in->count; i++) {
+                if (in->color[i] != from || (int)in->type[i] != type) continue;
+                out->type[out->count] = in->type[i];
+                out->color[out->count] = pass == 0 ? COLOR_WHITE : COLOR_BLACK;
+                out->square[out->count] = flip ? in->square[i] ^ 56 : in->square[i];
+                out->count++;
+                name[length++] = pieceLetters[type];
+            }
+        }
+        if (pass == 0) name[length++] = 'v';
+    }
+    name[length] = '\0';
+
+    return sideToMove == strong ? 0 : 1;
+}
+
+static int findBlackKing(const TbPieceList *pieces) {
+    for (int i = 1; i < pieces->count; i++) {
+        if (pieces->type[i] == KING) return i;
+    }
+    return -1;
+}
+
+static bool parseSignature(const char *signature, TbPieceList *pieces) {
+    ColorPieces color = COLOR_WHITE;
+    int kings[3] = {0};
+    pieces->count = 0;
+
+    for (const char *c = signature; *c; c++) {
+        if (*c == 'v' || *c == 'V') {
+            if (color == COLOR_BLACK) return false;
+            color = COLOR_BLACK;
+            continue;
+        }
+        const char *letter = strchr(pieceLetters + 1, *c);
+        if (!letter || pieces->count == TB_MAX_PIECES) return false;
+        PieceType type = (PieceType)(letter - pieceLetters);
+        if (type == PAWN) return false;
+        if (type == KING) kings[color]++;
+        pieces->type[pieces->count] = type;
+        pieces->color[pieces->count] = color;
+        pieces->square[pieces->count] = 0;
+        pieces->count++;
+    }
+    return color == COLOR_BLACK && kings[COLOR_WHITE] == 1 && kings[COLOR_BLACK] == 1;
+}
+
+bool tbCanonicalName(const char *signature, char name[16]) {
+    TbPieceList parsed, ordered;
+    if (!parseSignature(signature, &parsed) || parsed.count < 3) return false;
+    orderPieces(&parsed, COLOR_WHITE, &ordered, name);
+    return true;
+}
+
+// Collects every multiset of up to 'left' non-king pieces as a string of
+// letters, strongest first
+static int listSides(char sides[][TB_MAX_PIECES], int count, char *prefix, int length, int from, int left) {
+    static const char order[] = "QRBN";
+    prefix[length] = '\0';
+    strcpy(sides[count++], prefix);
+    if (left == 0) return count;
+    for (int i = from; i < 4; i++) {
+        prefix[length] = order[i];
+        count = listSides(sides, count, prefix, length + 1, i, left - 1);
+    }
+    return count;
+}
+
+int tbListSignatures(int maxPieces, char names[][16], int capacity) {
+    if (maxPieces > TB_MAX_PIECES) maxPieces = TB_MAX_PIECES;
+    if (maxPieces < 3) return 0;
+
+    char sides[64][TB_MAX_PIECES];
+    char prefix[TB_MAX_PIECES];
+    int sideCount = listSides(sides, 0, prefix, 0, 0, maxPieces - 2);
+    int count = 0;
+
+    for (int pieces = 3; pieces <= maxPieces; pieces++) {
+        for (int w = 0; w < sideCount; w++) {
+            for (int b = 0; b < sideCount; b++) {
+                if ((int)(strlen(sides[w]) + strlen(sides[b])) + 2 != pieces) continue;
+
+                char signature[16], name[16];
+                snprintf(signature, sizeof(signature), "K%svK%s", sides[w], sides[b]);
+                // Each table shows up twice, once per colour assignment
+                if (!tbCanonicalName(signature, name) || strcmp(name, signature) != 0) continue;
+                if (count == capacity) return count;
+                strcpy(names[count++], name);
+            }
+        }
+    }
+    return count;
+}
+
+bool tbLocate(const TbPieceList *pieces, ColorPieces sideToMove, TbLocation *location) {
+    if (pieces->count < 3 || pieces->count > TB_MAX_PIECES) return false;
+
+    int kings[3] = {0};
+    for (int i = 0; i < pieces->count; i++) {
+        if (pieces->type[i] == PAWN) return false;
+        if (pieces->type[i] == KING) kings[pieces->color[i]]++;
+    }
+    if (kings[COLOR_WHITE] != 1 || kings[COLOR_BLACK] != 1) return false;
+
+    pthread_once(&kingPairsOnce, initKingPairs);
+
+    TbPieceList ordered;
+    location->side = orderPieces(pieces, sideToMove, &ordered, location->name);
+    return encodeSquares(&ordered, findBlackKing(&ordered), &location->index);
+}
+
+// ---------------------------------------------------------------------------
+// Block codec: PackBits style runs and literals
+// ---------------------------------------------------------------------------
+
+// Token byte t < 128: t + 1 literal bytes follow.
+// Token byte t >= 128: the next byte repeats (t - 128) + 3 times.
+size_t tbCompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst) {
+    size_t in = 0, out = 0;
+    size_t literalStart = 0;
+
+    while (in < srcSize) {
+        size_t run = 1;
+        while (in + run < srcSize && run < 130 && src[in + run] == src[in]) {
+            run++;
+        }
+
+        if (run >= 3 || in + run == srcSize) {
+            // Flush pending literals
+            while (literalStart < in) {
+                size_t length = in - literalStart;
+                if (length > 128) length = 128;
+                dst[out++] = (uint8_t)(length - 1);
+                memcpy(dst + out, src + literalStart, length);
+                out += length;
+                literalStart += length;
+            }
+            if (run >= 3) {
+                dst[out++] = (uint8_t)(128 + run - 3);
+                dst[out++] = src[in];
+                in += run;
+                literalStart = in;
+                continue;
+            }
+        }
+        in += run;
+    }
+
+    while (literalStart < srcSize) {
+        size_t length = srcSize - literalStart;
+        if (length > 128) length = 128;
+        dst[out++] = (uint8_t)(length - 1);
+        memcpy(dst + out, src + literalStart, length);
+        out += length;
+        literalStart += length;
+    }
+    return out;
+}
+
+bool tbDecompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstSize) {
+    size_t in = 0, out = 0;
+    while (in < srcSize) {
+        uint8_t token = src[in++];
+        if (token < 128) {
+            size_t length = (size_t)token + 1;
+            if (in + length > srcSize || out + length > dstSize) return false;
+            memcpy(dst + out, src + in, length);
+            in += length;
+            out += length;
+        } else {
+            size_t length = (size_t)token - 128 + 3;
+            if (in >= srcSize || out + length > dstSize) return false;
+            memset(dst + out, src[in++], length);
+            out += length;
+        }
+    }
+    return out == dstSize;
+}
+
+// ---------------------------------------------------------------------------
+// Table files
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char name[16];
+    uint32_t entries;
+    uint8_t *data; // both sides, white to move first
+} LoadedTable;
+
+bool tbTablePath(const char *directory, const char *name, char *path, size_t size) {
+    int length = snprintf(path, size, "%s/%s%s", directory, name, TB_FILE_EXTENSION);
+    return length >= 0 && (size_t)length < size;
+}
+
+static bool fileExists(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+    fclose(file);
+    return true;
+}
+
+static bool loadTable(const char *path, const char *name, LoadedTable *table) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Cannot open tablebase %s\n", path);
+        return false;
+    }
+
+    TbFileHeader header;
+    uint64_t *offsets = NULL;
+    uint8_t *compressed = NULL;
+    bool ok = false;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != TB_MAGIC || header.version != TB_VERSION ||
+        strncmp(header.name, name, sizeof(header.name)) != 0 ||
+        header.entries != tbEntriesPerSide((int)header.pieceCount)) {
+        printf("Invalid tablebase header in %s\n", path);
+        goto done;
+    }
+
+    uint64_t total = (uint64_t)header.entries * 2;
+    offsets = malloc((header.blockCount + 1) * sizeof(uint64_t));
+    table->data = malloc(total);
+    if (!offsets || !table->data) goto done;
+    if (fread(offsets, sizeof(uint64_t), header.blockCount + 1, file) != header.blockCount + 1) goto done;
+
+    uint64_t compressedSize = offsets[header.blockCount] - offsets[0];
+    compressed = malloc(compressedSize ? compressedSize : 1);
+    if (!compressed || fread(compressed, 1, compressedSize, file) != compressedSize) goto done;
+
+    for (uint32_t block = 0; block < header.blockCount; block++) {
+        uint64_t start = (uint64_t)block * header.blockSize;
+        uint64_t size = total - start < header.blockSize ? total - start : header.blockSize;
+        if (!tbDecompressBlock(compressed + (offsets[block] - offsets[0]),
+                               offsets[block + 1] - offsets[block],
+                               table->data + start, size)) {
+            printf("Corrupt block %u in %s\n", block, path);
+            goto done;
+        }
+    }
+
+    memcpy(table->name, header.name, sizeof(table->name));
+    table->entries = header.entries;
+    ok = true;
+
+done:
+    if (!ok) {
+        free(table->data);
+        table->data = NULL;
+    }
+    free(compressed);
+    free(offsets);
+    fclose(file);
+    return ok;
+}
+
+static bool saveTable(const char *path, const char *name, int pieceCount, uint32_t entries, const uint8_t *data) {
+    uint64_t total = (uint64_t)entries * 2;
+    uint32_t blockCount = (uint32_t)((total + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE);
+
+    // Cleared as a whole so the unused tail of the name is written as zeros
+    TbFileHeader header;
+    memset(&header, 0, sizeof(header));
+    size_t nameLength = strlen(name);
+    if (nameLength >= sizeof(header.name)) {
+        printf("Table name too long: %s\n", name);
+        return false;
+    }
+    header.magic = TB_MAGIC;
+    header.version = TB_VERSION;
+    memcpy(header.name, name, nameLength);
+    header.pieceCount = (uint32_t)pieceCount;
+    header.entries = entries;
+    header.blockSize = TB_BLOCK_SIZE;
+    header.blockCount = blockCount;
+
+    uint64_t *offsets = malloc((blockCount + 1) * sizeof(uint64_t));
+    uint8_t block[TB_BLOCK_SIZE];
+    uint8_t packed[TB_BLOCK_SIZE + TB_BLOCK_SIZE / 128 + 16];
+
+    size_t tmpSize = strlen(path) + sizeof(".tmp");
+    char *tmpPath = malloc(tmpSize);
+    int tmpLength = tmpPath ? snprintf(tmpPath, tmpSize, "%s.tmp", path) : -1;
+    FILE *file = tmpLength >= 0 && (size_t)tmpLength < tmpSize ? fopen(tmpPath, "wb") : NULL;
+    if (!offsets || !file) {
+        printf("Cannot write tablebase %s.tmp\n", path);
+        free(offsets);
+        free(tmpPath);
+        if (file) fclose(file);
+        return false;
+    }
+
+    // Reserve room for the header and offsets, filled in at the end
+    long dataStart = (long)(sizeof(header) + (blockCount + 1) * sizeof(uint64_t));
+    fseek(file, dataStart, SEEK_SET);
+
+    uint64_t offset = (uint64_t)dataStart;
+    uint8_t previous = TB_DRAW;
+    bool ok = true;
+    for (uint32_t b = 0; b < blockCount && ok; b++) {
+        uint64_t start = (uint64_t)b * TB_BLOCK_SIZE;
+        size_t size = total - start < TB_BLOCK_SIZE ? (size_t)(total - start) : TB_BLOCK_SIZE;
+
+        // Illegal entries are never probed, so they repeat the previous
+        // value to make longer runs
+        for (size_t i = 0; i < size; i++) {
+            uint8_t value = data[start + i];
+            if (value == TB_ILLEGAL) value = previous;
+            block[i] = previous = value;
+        }
+
+        size_t packedSize = tbCompressBlock(block, size, packed);
+        offsets[b] = offset;
+        ok = fwrite(packed, 1, packedSize, file) == packedSize;
+        offset += packedSize;
+    }
+    offsets[blockCount] = offset;
+
+    fseek(file, 0, SEEK_SET);
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(offsets, sizeof(uint64_t), blockCount + 1, file) == blockCount + 1;
+    ok = (fclose(file) == 0) && ok;
+    free(offsets);
+
+    remove(path);
+    if (!ok || rename(tmpPath, path) != 0) {
+        printf("Failed to write tablebase %s\n", path);
+        remove(tmpPath);
+        free(tmpPath);
+        return false;
+    }
+    free(tmpPath);
+
+    printf("%s: %llu bytes on disk for %llu entries\n", name,
+           (unsigned long long)offset, (unsigned long long)total);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Generator
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    PHASE_INIT,
+    PHASE_RETRO,
+    PHASE_PENDING
+} Phase;
+
+typedef struct {
+    uint32_t *slots;
+    uint8_t *values;
+    size_t count;
+    size_t capacity;
+} ResultList;
+
+typedef struct Generator Generator;
+
+typedef struct {
+    Generator *gen;
+    pthread_t thread;
+    ResultList results;
+    bool failed;
+} Worker;
+
+struct Generator {
+    char name[16];
+    TbPieceList layout;
+    int blackKingSlot;
+    uint32_t entries;
+    uint8_t *data; // slot = side * entries + index
+
+    LoadedTable subTables[MAX_SUB_TABLES];
+    int subTableCount;
+
+    Phase phase;
+    int ply;
+    const uint32_t *pendingSlots;
+    uint64_t itemCount;
+
+    pthread_mutex_t lock;
+    uint64_t nextChunk;
+
+    Worker *workers;
+    int threadCount;
+};
+
+// A position being worked on: squares in table order plus a square ->
+// piece slot map (-1 for empty)
+typedef struct {
+    TbPieceList pieces;
+    int8_t board[64];
+} GenPosition;
+
+typedef struct {
+    int slot;
+    int to;
+    int captured; // piece slot, or -1
+} GenMove;
+
+static bool pushResult(ResultList *list, uint32_t slot, uint8_t value) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 4096;
+        uint32_t *slots = realloc(list->slots, capacity * sizeof(uint32_t));
+        if (!slots) return false;
+        list->slots = slots;
+        uint8_t *values = realloc(list->values, capacity);
+        if (!values) return false;
+        list->values = values;
+        list->capacity = capacity;
+    }
+    list->slots[list->count] = slot;
+    list->values[list->count] = value;
+    list->count++;
+    return true;
+}
+
+static void setupBoard(GenPosition *pos) {
+    memset(pos->board, -1, sizeof(pos->board));
+    for (int i = 0; i < pos->pieces.count; i++) {
+        pos->board[pos->pieces.square[i]] = (int8_t)i;
+    }
+}
+
+// Squares a piece reaches from 'from'. Sliders stop on the first occupied
+// square, which is included so the caller can decide about captures.
+static int pieceTargets(PieceType type, int from, const int8_t *board, int targets[28]) {
+    int count = 0;
+    int file = from & 7;
+    int rank = from >> 3;
+
+    if (type == KING || type == KNIGHT) {
+        const int (*steps)[2] = type == KING ? kingSteps : knightJumps;
+        for (int i = 0; i < 8; i++) {
+            int f = file + steps[i][0];
+            int r = rank + steps[i][1];
+            if (f >= 0 && f < 8 && r >= 0 && r < 8) {
+                targets[count++] = TB_SQUARE(f, r);
+            }
+        }
+        return count;
+    }
+
+    int first = type == BISHOP ? 4 : 0;
+    int last = type == ROOK ? 4 : 8;
+    for (int d = first; d < last; d++) {
+        int f = file + rays[d][0];
+        int r = rank + rays[d][1];
+        while (f >= 0 && f < 8 && r >= 0 && r < 8) {
+            int square = TB_SQUARE(f, r);
+            targets[count++] = square;
+            if (board[square] >= 0) break;
+            f += rays[d][0];
+            r += rays[d][1];
+        }
+    }
+    return count;
+}
+
+static bool pieceAttacks(PieceType type, int from, int target, const int8_t *board) {
+    int dx = (target & 7) - (from & 7);
+    int dy = (target >> 3) - (from >> 3);
+    int adx = abs(dx), ady = abs(dy);
+
+    switch (type) {
+        case KING:
+            return adx <= 1 && ady <= 1 && (adx | ady);
+        case KNIGHT:
+            return (adx == 1 && ady == 2) || (adx == 2 && ady == 1);
+        case BISHOP:
+            if (adx != ady || adx == 0) return false;
+            break;
+        case ROOK:
+            if ((dx && dy) || (adx | ady) == 0) return false;
+            break;
+        case QUEEN:
+            if (((dx && dy) && adx != ady) || (adx | ady) == 0) return false;
+            break;
+        default:
+            return false;
+    }
+
+    int stepX = (dx > 0) - (dx < 0);
+    int stepY = (dy > 0) - (dy < 0);
+    int square = from + stepY * 8 + stepX;
+    while (square != target) {
+        if (board[square] >= 0) return false;
+        square += stepY * 8 + stepX;
+    }
+    return true;
+}
+
+static bool isAttacked(const GenPosition *pos, int target, ColorPieces by) {
+    for (int i = 0; i < pos->pieces.count; i++) {
+        if (pos->pieces.color[i] == by && pos->pieces.square[i] >= 0 &&
+            pieceAttacks(pos->pieces.type[i], pos->pieces.square[i], target, pos->board)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static ColorPieces sideColor(int side) {
+    return side == 0 ? COLOR_WHITE : COLOR_BLACK;
+}
+
+static void applyGenMove(GenPosition *pos, const GenMove *move) {
+    int from = pos->pieces.square[move->slot];
+    if (move->captured >= 0) pos->pieces.square[move->captured] = -1;
+    pos->board[from] = -1;
+    pos->board[move->to] = (int8_t)move->slot;
+    pos->pieces.square[move->slot] = move->to;
+}
+
+static int generateMoves(const Generator *gen, const GenPosition *pos, int side, GenMove *moves) {
+    ColorPieces us = sideColor(side);
+    ColorPieces them = sideColor(1 - side);
+    int kingSlot = side == 0 ? 0 : gen->blackKingSlot;
+    int count = 0;
+
+    for (int i = 0; i < pos->pieces.count; i++) {
+        if (pos->pieces.color[i] != us) continue;
+
+        int targets[28];
+        int targetCount = pieceTargets(pos->pieces.type[i], pos->pieces.square[i], pos->board, targets);
+        for (int t = 0; t < targetCount; t++) {
+            int occupant = pos->board[targets[t]];
+            if (occupant >= 0 && pos->pieces.color[occupant] == us) continue;
+
+            GenMove move = {i, targets[t], occupant};
+            GenPosition after = *pos;
+            applyGenMove(&after, &move);
+            if (!isAttacked(&after, after.pieces.square[kingSlot], them)) {
+                moves[count++] = move;
+            }
+        }
+    }
+    return count;
+}
+
+static const LoadedTable *findSubTable(const Generator *gen, const char *name) {
+    for (int i = 0; i < gen->subTableCount; i++) {
+        if (strcmp(gen->subTables[i].name, name) == 0) return &gen->subTables[i];
+    }
+    return NULL;
+}
+
+// Value of the position reached by a legal move, seen from the opponent
+static uint8_t successorValue(const Generator *gen, const GenPosition *pos, int side, const GenMove *move) {
+    GenPosition after = *pos;
+    applyGenMove(&after, move);
+
+    if (move->captured < 0) {
+        uint32_t index;
+        if (!encodeSquares(&after.pieces, gen->blackKingSlot, &index)) return TB_ILLEGAL;
+        return gen->data[(uint64_t)(1 - side) * gen->entries + index];
+    }
+
+    TbPieceList remaining = {0};
+    for (int i = 0; i < after.pieces.count; i++) {
+        if (i == move->captured) continue;
+        remaining.type[remaining.count] = after.pieces.type[i];
+        remaining.color[remaining.count] = after.pieces.color[i];
+        remaining.square[remaining.count] = after.pieces.square[i];
+        remaining.count++;
+    }
+    if (remaining.count == 2) return TB_DRAW;
+
+    TbLocation location;
+    if (!tbLocate(&remaining, sideColor(1 - side), &location)) return TB_ILLEGAL;
+    const LoadedTable *table = findSubTable(gen, location.name);
+    if (!table) return TB_ILLEGAL;
+    return table->data[(uint64_t)location.side * table->entries + location.index];
+}
+
+static void decodeSlot(const Generator *gen, uint32_t slot, GenPosition *pos, int *side) {
+    *side = slot >= gen->entries ? 1 : 0;
+    pos->pieces = gen->layout;
+    decodeSquares(&pos->pieces, gen->blackKingSlot, slot - (uint32_t)*side * gen->entries);
+    setupBoard(pos);
+}
+
+// Resolves a position from its successors, using only values already
+// known at the current ply. Returns TB_DRAW if it is still undecided.
+static uint8_t resolveForward(const Generator *gen, const GenPosition *pos, int side) {
+    GenMove moves[MAX_GEN_MOVES];
+    int count = generateMoves(gen, pos, side, moves);
+    int bestLoss = -1;
+    int worstWin = -1;
+    bool allWins = count > 0;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t value = successorValue(gen, pos, side, &moves[i]);
+        if (value == TB_DRAW || value == TB_ILLEGAL || value > gen->ply) {
+            allWins = false;
+            continue;
+        }
+        int distance = value - 1;
+        if (distance % 2 == 0) {
+            if (bestLoss < 0 || distance < bestLoss) bestLoss = distance;
+            allWins = false;
+        } else if (distance > worstWin) {
+            worstWin = distance;
+        }
+    }
+
+    if (bestLoss >= 0) return (uint8_t)(bestLoss + 2);
+    if (allWins) return (uint8_t)(worstWin + 2);
+    return TB_DRAW;
+}
+
+// Marks illegal positions and mates, and schedules positions whose value
+// depends on captures into smaller tables
+static bool initSlot(Generator *gen, Worker *worker, uint32_t slot) {
+    GenPosition pos;
+    int side;
+    decodeSlot(gen, slot, &pos, &side);
+
+    for (int i = 0; i < pos.pieces.count; i++) {
+        for (int j = i + 1; j < pos.pieces.count; j++) {
+            if (pos.pieces.square[i] == pos.pieces.square[j]) {
+                gen->data[slot] = TB_ILLEGAL;
+                return true;
+            }
+        }
+    }
+
+    // Mirror images of positions with both kings on the diagonal are
+    // stored once; the other entry is never looked up
+    uint32_t index;
+    if (encodeSquares(&pos.pieces, gen->blackKingSlot, &index) &&
+        index != slot - (uint32_t)side * gen->entries) {
+        gen->data[slot] = TB_ILLEGAL;
+        return true;
+    }
+
+    int theirKing = side == 0 ? gen->blackKingSlot : 0;
+    if (isAttacked(&pos, pos.pieces.square[theirKing], sideColor(side))) {
+        gen->data[slot] = TB_ILLEGAL;
+        return true;
+    }
+
+    GenMove moves[MAX_GEN_MOVES];
+    int count = generateMoves(gen, &pos, side, moves);
+    if (count == 0) {
+        int ourKing = side == 0 ? 0 : gen->blackKingSlot;
+        bool inCheck = isAttacked(&pos, pos.pieces.square[ourKing], sideColor(1 - side));
+        gen->data[slot] = inCheck ? 1 : TB_DRAW;
+        return true;
+    }
+
+    int bestLoss = -1;
+    int worstWin = -1;
+    bool capturesAllWin = true;
+    bool anyCapture = false;
+    for (int i = 0; i < count; i++) {
+        if (moves[i].captured < 0) continue;
+        anyCapture = true;
+        uint8_t value = successorValue(gen, &pos, side, &moves[i]);
+        if (value == TB_DRAW || value == TB_ILLEGAL) {
+            capturesAllWin = false;
+            continue;
+        }
+        int distance = value - 1;
+        if (distance % 2 == 0) {
+            if (bestLoss < 0 || distance < bestLoss) bestLoss = distance;
+            capturesAllWin = false;
+        } else if (distance > worstWin) {
+            worstWin = distance;
+        }
+    }
+
+    // Pending entries carry the value the position would get, which is
+    // also the ply after which it has to be looked at again
+    gen->data[slot] = TB_DRAW;
+    if (bestLoss >= 0 && bestLoss + 1 <= MAX_DISTANCE) {
+        return pushResult(&worker->results, slot, (uint8_t)(bestLoss + 2));
+    }
+    if (anyCapture && capturesAllWin && worstWin + 1 <= MAX_DISTANCE) {
+        return pushResult(&worker->results, slot, (uint8_t)(worstWin + 2));
+    }
+    return true;
+}
+
+// Walks back from a position decided at the previous ply: every
+// predecessor of a loss is a win, predecessors of a win are re-checked
+static bool retroSlot(Generator *gen, Worker *worker, uint32_t slot) {
+    if (gen->data[slot] != gen->ply) return true;
+
+    GenPosition pos;
+    int side;
+    decodeSlot(gen, slot, &pos, &side);
+    bool isLoss = (gen->ply - 1) % 2 == 0;
+    int prevSide = 1 - side;
+    ColorPieces mover = sideColor(prevSide);
+
+    for (int i = 0; i < pos.pieces.count; i++) {
+        if (pos.pieces.color[i] != mover) continue;
+
+        // Pawnless pieces move symmetrically, so the squares a piece could
+        // have come from are its empty target squares
+        int targets[28];
+        int targetCount = pieceTargets(pos.pieces.type[i], pos.pieces.square[i], pos.board, targets);
+        for (int t = 0; t < targetCount; t++) {
+            if (pos.board[targets[t]] >= 0) continue;
+
+            GenPosition before = pos;
+            GenMove unmove = {i, targets[t], -1};
+            applyGenMove(&before, &unmove);
+
+            uint32_t index;
+            if (!encodeSquares(&before.pieces, gen->blackKingSlot, &index)) continue;
+            uint32_t prevSlot = (uint32_t)prevSide * gen->entries + index;
+            if (gen->data[prevSlot] != TB_DRAW) continue;
+
+            uint8_t value = isLoss ? (uint8_t)(gen->ply + 1) : resolveForward(gen, &before, prevSide);
+            if (value != TB_DRAW && !pushResult(&worker->results, prevSlot, value)) return false;
+        }
+    }
+    return true;
+}
+
+static bool pendingSlot(Generator *gen, Worker *worker, uint32_t slot) {
+    if (gen->data[slot] != TB_DRAW) return true;
+
+    GenPosition pos;
+    int side;
+    decodeSlot(gen, slot, &pos, &side);
+    uint8_t value = resolveForward(gen, &pos, side);
+    return value == TB_DRAW || pushResult(&worker->results, slot, value);
+}
+
+static bool claimChunk(Generator *gen, uint64_t *begin, uint64_t *end) {
+    pthread_mutex_lock(&gen->lock);
+    uint64_t chunk = gen->nextChunk++;
+    pthread_mutex_unlock(&gen->lock);
+
+    *begin = chunk * CHUNK_SIZE;
+    if (*begin >= gen->itemCount) return false;
+    *end = *begin + CHUNK_SIZE < gen->itemCount ? *begin + CHUNK_SIZE : gen->itemCount;
+    return true;
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    Generator *gen = worker->gen;
+    uint64_t begin, end;
+
+    while (!worker->failed && claimChunk(gen, &begin, &end)) {
+        for (uint64_t i = begin; i < end && !worker->failed; i++) {
+            bool ok;
+            switch (gen->phase) {
+                case PHASE_INIT:
+                    ok = initSlot(gen, worker, (uint32_t)i);
+                    break;
+                case PHASE_RETRO:
+                    ok = retroSlot(gen, worker, (uint32_t)i);
+                    break;
+                default:
+                    ok = pendingSlot(gen, worker, gen->pendingSlots[i]);
+                    break;
+            }
+            worker->failed = !ok;
+        }
+    }
+    return NULL;
+}
+
+static bool runPhase(Generator *gen, Phase phase, uint64_t itemCount) {
+    gen->phase = phase;
+    gen->itemCount = itemCount;
+    gen->nextChunk = 0;
+
+    int started = 0;
+    for (int i = 0; i < gen->threadCount; i++) {
+        Worker *worker = &gen->workers[i];
+        worker->gen = gen;
+        worker->failed = false;
+        if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        workerMain(&gen->workers[0]);
+        started = 1;
+    } else {
+        for (int i = 0; i < started; i++) {
+            pthread_join(gen->workers[i].thread, NULL);
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        if (gen->workers[i].failed) {
+            printf("%s: out of memory\n", gen->name);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes the values found by the workers; returns how many were new
+static uint64_t applyResults(Generator *gen) {
+    uint64_t applied = 0;
+    for (int i = 0; i < gen->threadCount; i++) {
+        ResultList *list = &gen->workers[i].results;
+        for (size_t r = 0; r < list->count; r++) {
+            if (gen->data[list->slots[r]] == TB_DRAW) {
+                gen->data[list->slots[r]] = list->values[r];
+                applied++;
+            }
+        }
+        list->count = 0;
+    }
+    return applied;
+}
+
+// Sorts the captures-into-smaller-tables found during init by the ply at
+// which they become relevant
+static bool bucketPending(Generator *gen, uint32_t **slots, uint64_t starts[TB_ILLEGAL + 1]) {
+    uint64_t counts[TB_ILLEGAL + 1] = {0};
+    uint64_t total = 0;
+    for (int i = 0; i < gen->threadCount; i++) {
+        ResultList *list = &gen->workers[i].results;
+        for (size_t r = 0; r < list->count; r++) {
+            counts[list->values[r]]++;
+        }
+        total += list->count;
+    }
+
+    *slots = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (!*slots) return false;
+
+    starts[0] = 0;
+    for (int ply = 1; ply <= TB_ILLEGAL; ply++) {
+        starts[ply] = starts[ply - 1] + counts[ply - 1];
+    }
+    uint64_t fill[TB_ILLEGAL + 1];
+    memcpy(fill, starts, sizeof(fill));
+    for (int i = 0; i < gen->threadCount; i++) {
+        ResultList *list = &gen->workers[i].results;
+        for (size_t r = 0; r < list->count; r++) {
+            (*slots)[fill[list->values[r]]++] = list->slots[r];
+        }
+        list->count = 0;
+    }
+    return true;
+}
+
+static bool loadSubTables(Generator *gen, const char *directory, int threads) {
+    for (int removed = 1; removed < gen->layout.count; removed++) {
+        if (removed == gen->blackKingSlot) continue;
+
+        TbPieceList sub = {0};
+        for (int i = 0; i < gen->layout.count; i++) {
+            if (i == removed) continue;
+            sub.type[sub.count] = gen->layout.type[i];
+            sub.color[sub.count] = gen->layout.color[i];
+            sub.count++;
+        }
+        if (sub.count == 2) continue;
+
+        TbPieceList ordered;
+        char name[16];
+        orderPieces(&sub, COLOR_WHITE, &ordered, name);
+        if (findSubTable(gen, name)) continue;
+
+        char path[512];
+        if (!tbTablePath(directory, name, path, sizeof(path))) {
+            printf("Tablebase path too long: %s/%s\n", directory, name);
+            return false;
+        }
+        if (!fileExists(path) && !tbGenerate(name, directory, threads)) return false;
+
+        LoadedTable *table = &gen->subTables[gen->subTableCount];
+        if (!loadTable(path, name, table)) return false;
+        gen->subTableCount++;
+    }
+    return true;
+}
+
+static void reportTable(const Generator *gen) {
+    for (int side = 0; side < 2; side++) {
+        uint64_t wins = 0, losses = 0, draws = 0;
+        int longest = -1;
+        const uint8_t *data = gen->data + (uint64_t)side * gen->entries;
+        for (uint32_t i = 0; i < gen->entries; i++) {
+            uint8_t value = data[i];
+            if (value == TB_ILLEGAL) continue;
+            if (value == TB_DRAW) {
+                draws++;
+            } else if ((value - 1) % 2 == 1) {
+                wins++;
+                if (value - 1 > longest) longest = value - 1;
+            } else {
+                losses++;
+            }
+        }
+        printf("%s %s to move: %llu wins, %llu draws, %llu losses",
+               gen->name, side == 0 ? "white" : "black",
+               (unsigned long long)wins, (unsigned long long)draws, (unsigned long long)losses);
+        if (longest >= 0) printf(", longest win %d plies", longest);
+        printf("\n");
+    }
+}
+
+bool tbGenerate(const char *signature, const char *directory, int threads) {
+    char name[16];
+    if (!tbCanonicalName(signature, name)) {
+        printf("Invalid or unsupported signature: %s\n", signature);
+        return false;
+    }
+
+    char path[512];
+    if (!tbTablePath(directory, name, path, sizeof(path))) {
+        printf("Tablebase path too long: %s/%s\n", directory, name);
+        return false;
+    }
+    if (fileExists(path)) {
+        printf("%s: already on disk\n", name);
+        return true;
+    }
+
+    pthread_once(&kingPairsOnce, initKingPairs);
+
+    Generator *gen = calloc(1, sizeof(Generator));
+    if (!gen) return false;
+    TbPieceList parsed;
+    parseSignature(name, &parsed);
+    orderPieces(&parsed, COLOR_WHITE, &gen->layout, gen->name);
+    gen->blackKingSlot = findBlackKing(&gen->layout);
+    gen->entries = tbEntriesPerSide(gen->layout.count);
+    gen->threadCount = threads > 0 ? threads : 1;
+    pthread_mutex_init(&gen->lock, NULL);
+
+    bool ok = false;
+    uint32_t *pending = NULL;
+    uint64_t pendingStart[TB_ILLEGAL + 1];
+
+    if (!loadSubTables(gen, directory, threads)) goto done;
+
+    printf("%s: generating %llu positions with %d threads\n", name,
+           (unsigned long long)gen->entries * 2, gen->threadCount);
+
+    gen->data = malloc((uint64_t)gen->entries * 2);
+    gen->workers = calloc((size_t)gen->threadCount, sizeof(Worker));
+    if (!gen->data || !gen->workers) {
+        printf("%s: out of memory\n", name);
+        goto done;
+    }
+
+    if (!runPhase(gen, PHASE_INIT, (uint64_t)gen->entries * 2)) goto done;
+    if (!bucketPending(gen, &pending, pendingStart)) goto done;
+
+    for (gen->ply = 1; gen->ply <= MAX_DISTANCE; gen->ply++) {
+        if (!runPhase(gen, PHASE_RETRO, (uint64_t)gen->entries * 2)) goto done;
+
+        // Captures into smaller tables that start to matter at this ply
+        int ply = gen->ply + 1;
+        gen->pendingSlots = pending + pendingStart[ply];
+        if (!runPhase(gen, PHASE_PENDING, pendingStart[ply + 1] - pendingStart[ply])) goto done;
+
+        uint64_t applied = applyResults(gen);
+        bool morePending = pendingStart[TB_ILLEGAL] > pendingStart[ply + 1];
+        if (applied) printf("%s: ply %d, %llu positions\n", name, gen->ply, (unsigned long long)applied);
+        if (!applied && !morePending) break;
+    }
+
+    reportTable(gen);
+    ok = saveTable(path, name, gen->layout.count, gen->entries, gen->data);
+
+done:
+    for (int i = 0; gen->workers && i < gen->threadCount; i++) {
+        free(gen->workers[i].results.slots);
+        free(gen->workers[i].results.values);
+    }
+    for (int i = 0; i < gen->subTableCount; i++) {
+        free(gen->subTables[i].data);
+    }
+    pthread_mutex_destroy(&gen->lock);
+    free(pending);
+    free(gen->workers);
+    free(gen->data);
+    free(gen);
+    return ok;
+}
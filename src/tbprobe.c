@@ -0,0 +1,353 @@
+#include "tbprobe.h"
+#include "platform.h"
+#include "tablebase.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The block cache is split into shards with their own lock and LRU list
+// so threads probing different blocks rarely wait on each other
+#define CACHE_SHARDS 16
+#define TABLE_SLOTS 512 // open addressing, more than TB_MAX_SIGNATURES
+#define NO_SLOT -1
+
+typedef struct {
+    char name[16];
+    MappedFile file;
+    const TbFileHeader *header;
+    const uint64_t *offsets;
+    uint64_t total; // entries of both sides
+} ProbeTable;
+
+typedef struct {
+    uint64_t key; // table << 32 | block
+    int prev, next;
+    int chain;
+    uint8_t *data;
+} CacheSlot;
+
+typedef struct {
+    pthread_mutex_t lock;
+    CacheSlot *slots;
+    int slotCount;
+    int *buckets;
+    int bucketMask;
+    int head, tail; // most and least recently used
+} CacheShard;
+
+static ProbeTable tables[TB_MAX_SIGNATURES];
+static int tableCount = 0;
+static short tableSlots[TABLE_SLOTS];
+static int largestTable = 0;
+
+static CacheShard shards[CACHE_SHARDS];
+static uint8_t *cacheMemory = NULL;
+
+static uint32_t hashName(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash;
+}
+
+static int findTable(const char *name) {
+    for (uint32_t i = hashName(name);; i++) {
+        int table = tableSlots[i & (TABLE_SLOTS - 1)];
+        if (table == NO_SLOT) return NO_SLOT;
+        if (strcmp(tables[table].name, name) == 0) return table;
+    }
+}
+
+static bool mapTable(const char *directory, const char *name, ProbeTable *table) {
+    // A path that does not fit is treated like a missing table
+    char path[512];
+    if (!tbTablePath(directory, name, path, sizeof(path))) return false;
+    if (!platformMapFile(path, &table->file)) return false;
+
+    const TbFileHeader *header = (const TbFileHeader *)table->file.data;
+    uint64_t total = 0;
+    bool valid = table->file.size >= sizeof(TbFileHeader) &&
+                 header->magic == TB_MAGIC && header->version == TB_VERSION &&
+                 header->blockSize == TB_BLOCK_SIZE &&
+                 strncmp(header->name, name, sizeof(header->name)) == 0 &&
+                 header->entries == tbEntriesPerSide((int)header->pieceCount);
+    if (valid) {
+        total = (uint64_t)header->entries * 2;
+        uint64_t offsetsEnd = sizeof(TbFileHeader) + ((uint64_t)header->blockCount + 1) * sizeof(uint64_t);
+        valid = header->blockCount == (total + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE &&
+                offsetsEnd <= table->file.size;
+    }
+    if (valid) {
+        const uint64_t *offsets = (const uint64_t *)(table->file.data + sizeof(TbFileHeader));
+        valid = offsets[header->blockCount] <= table->file.size;
+    }
+    if (!valid) {
+        printf("Ignoring invalid tablebase %s\n", path);
+        platformUnmapFile(&table->file);
+        return false;
+    }
+
+    strcpy(table->name, name);
+    table->header = header;
+    table->offsets = (const uint64_t *)(table->file.data + sizeof(TbFileHeader));
+    table->total = total;
+    return true;
+}
+
+static bool initCache(size_t cacheBytes) {
+    int perShard = (int)(cacheBytes / TB_BLOCK_SIZE / CACHE_SHARDS);
+    if (perShard < 4) perShard = 4;
+
+    int buckets = 1;
+    while (buckets < perShard * 2) buckets <<= 1;
+
+    cacheMemory = malloc((size_t)perShard * CACHE_SHARDS * TB_BLOCK_SIZE);
+    if (!cacheMemory) return false;
+
+    for (int s = 0; s < CACHE_SHARDS; s++) {
+        CacheShard *shard = &shards[s];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->slots = malloc((size_t)perShard * sizeof(CacheSlot));
+        shard->buckets = malloc((size_t)buckets * sizeof(int));
+        if (!shard->slots || !shard->buckets) return false;
+
+        shard->slotCount = perShard;
+        shard->bucketMask = buckets - 1;
+        for (int b = 0; b < buckets; b++) shard->buckets[b] = NO_SLOT;
+
+        // Every slot starts out empty and linked into the LRU list
+        for (int i = 0; i < perShard; i++) {
+            CacheSlot *slot = &shard->slots[i];
+            slot->key = UINT64_MAX;
+            slot->prev = i - 1;
+            slot->next = i + 1 < perShard ? i + 1 : NO_SLOT;
+            slot->chain = NO_SLOT;
+            slot->data = cacheMemory + ((size_t)s * perShard + i) * TB_BLOCK_SIZE;
+        }
+        shard->head = 0;
+        shard->tail = perShard - 1;
+    }
+    return true;
+}
+
+int tbProbeInit(const char *directory, size_t cacheBytes) {
+    tbProbeClose();
+
+    for (int i = 0; i < TABLE_SLOTS; i++) tableSlots[i] = NO_SLOT;
+
+    char names[TB_MAX_SIGNATURES][16];
+    int count = tbListSignatures(TB_MAX_PIECES, names, TB_MAX_SIGNATURES);
+    for (int i = 0; i < count; i++) {
+        ProbeTable *table = &tables[tableCount];
+        if (!mapTable(directory, names[i], table)) continue;
+
+        uint32_t slot = hashName(table->name);
+        while (tableSlots[slot & (TABLE_SLOTS - 1)] != NO_SLOT) slot++;
+        tableSlots[slot & (TABLE_SLOTS - 1)] = (short)tableCount;
+        if ((int)table->header->pieceCount > largestTable) {
+            largestTable = (int)table->header->pieceCount;
+        }
+        tableCount++;
+    }
+
+    if (tableCount > 0 && !initCache(cacheBytes)) {
+        printf("Failed to allocate tablebase cache\n");
+        tbProbeClose();
+        return 0;
+    }
+    return tableCount;
+}
+
+void tbProbeClose(void) {
+    for (int i = 0; i < tableCount; i++) {
+        platformUnmapFile(&tables[i].file);
+    }
+    if (cacheMemory) {
+        for (int s = 0; s < CACHE_SHARDS; s++) {
+            pthread_mutex_destroy(&shards[s].lock);
+            free(shards[s].slots);
+            free(shards[s].buckets);
+        }
+        free(cacheMemory);
+        cacheMemory = NULL;
+    }
+    memset(shards, 0, sizeof(shards));
+    tableCount = 0;
+    largestTable = 0;
+}
+
+int tbProbePieces(void) {
+    return largestTable;
+}
+
+static void unlinkSlot(CacheShard *shard, int index) {
+    CacheSlot *slot = &shard->slots[index];
+    if (slot->prev != NO_SLOT) shard->slots[slot->prev].next = slot->next;
+    else shard->head = slot->next;
+    if (slot->next != NO_SLOT) shard->slots[slot->next].prev = slot->prev;
+    else shard->tail = slot->prev;
+}
+
+static void pushFront(CacheShard *shard, int index) {
+    CacheSlot *slot = &shard->slots[index];
+    slot->prev = NO_SLOT;
+    slot->next = shard->head;
+    if (shard->head != NO_SLOT) shard->slots[shard->head].prev = index;
+    shard->head = index;
+    if (shard->tail == NO_SLOT) shard->tail = index;
+}
+
+static void removeFromChain(CacheShard *shard, int index) {
+    int *link = &shard->buckets[shard->slots[index].key & (uint64_t)shard->bucketMask];
+    while (*link != index) link = &shard->slots[*link].chain;
+    *link = shard->slots[index].chain;
+}
+
+// Reads one entry, going through the block cache
+static bool readEntry(int tableIndex, uint64_t position, uint8_t *value) {
+    const ProbeTable *table = &tables[tableIndex];
+    uint32_t block = (uint32_t)(position / TB_BLOCK_SIZE);
+    uint64_t key = (uint64_t)tableIndex << 32 | block;
+    // Spread neighbouring blocks over the shards
+    uint64_t mixed = key * 0x9E3779B97F4A7C15ull;
+    CacheShard *shard = &shards[mixed >> 60];
+
+    pthread_mutex_lock(&shard->lock);
+
+    int index = shard->buckets[key & (uint64_t)shard->bucketMask];
+    while (index != NO_SLOT && shard->slots[index].key != key) {
+        index = shard->slots[index].chain;
+    }
+
+    if (index == NO_SLOT) {
+        // Miss: recycle the least recently used slot
+        index = shard->tail;
+        CacheSlot *slot = &shard->slots[index];
+        if (slot->key != UINT64_MAX) removeFromChain(shard, index);
+        slot->key = UINT64_MAX;
+
+        uint64_t start = (uint64_t)block * TB_BLOCK_SIZE;
+        size_t size = table->total - start < TB_BLOCK_SIZE ? (size_t)(table->total - start) : TB_BLOCK_SIZE;
+        uint64_t from = table->offsets[block];
+        uint64_t to = table->offsets[block + 1];
+        if (from > to || to > table->file.size ||
+            !tbDecompressBlock(table->file.data + from, (size_t)(to - from), slot->data, size)) {
+            pthread_mutex_unlock(&shard->lock);
+            return false;
+        }
+
+        slot->key = key;
+        uint64_t bucket = key & (uint64_t)shard->bucketMask;
+        slot->chain = shard->buckets[bucket];
+        shard->buckets[bucket] = index;
+    }
+
+    if (shard->head != index) {
+        unlinkSlot(shard, index);
+        pushFront(shard, index);
+    }
+    *value = shard->slots[index].data[position % TB_BLOCK_SIZE];
+
+    pthread_mutex_unlock(&shard->lock);
+    return true;
+}
+
+// Raw table value for the side to move: TB_DRAW, a distance code, or
+// TB_ILLEGAL when there is no table for the position
+static uint8_t probeValue(const GameState *game) {
+    if (tableCount == 0) return TB_ILLEGAL;
+
+    TbPieceList pieces = {0};
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (piece == EMPTY) continue;
+            if (pieces.count == largestTable) return TB_ILLEGAL;
+            pieces.type[pieces.count] = PIECE_TYPE(piece);
+            pieces.color[pieces.count] = PIECE_COLOR(piece);
+            pieces.square[pieces.count] = TB_SQUARE(x, 7 - y);
+            pieces.count++;
+        }
+    }
+
+    // Bare kings are a draw without any table
+    if (pieces.count == 2) return TB_DRAW;
+    // Castling is not part of the tables, so positions that still allow it
+    // cannot be probed
+    if (game->castling) return TB_ILLEGAL;
+
+    TbLocation location;
+    if (!tbLocate(&pieces, game->currentTurn, &location)) return TB_ILLEGAL;
+    int table = findTable(location.name);
+    if (table == NO_SLOT) return TB_ILLEGAL;
+
+    uint8_t value;
+    uint64_t position = (uint64_t)location.side * tables[table].header->entries + location.index;
+    if (!readEntry(table, position, &value)) return TB_ILLEGAL;
+    return value;
+}
+
+bool tbProbeWDL(const GameState *game, TbWdl *wdl) {
+    int plies;
+    return tbProbeDTM(game, wdl, &plies);
+}
+
+bool tbProbeDTM(const GameState *game, TbWdl *wdl, int *plies) {
+    uint8_t value = probeValue(game);
+    if (value == TB_ILLEGAL) return false;
+
+    if (value == TB_DRAW) {
+        *wdl = TB_WDL_DRAW;
+        *plies = 0;
+    } else {
+        *plies = value - 1;
+        *wdl = *plies % 2 ? TB_WIN : TB_LOSS;
+    }
+    return true;
+}
+
+// Orders root results: quick mates first, then draws, then the longest
+// resistance
+static int rootScore(TbWdl wdl, int plies) {
+    if (wdl == TB_WIN) return 1000 - plies;
+    if (wdl == TB_LOSS) return -1000 + plies;
+    return 0;
+}
+
+bool tbProbeRoot(const GameState *game, Move *best, TbWdl *wdl, int *plies) {
+    TbWdl rootWdl;
+    int rootPlies;
+    if (!tbProbeDTM(game, &rootWdl, &rootPlies)) return false;
+
+    // generateLegalMoves works on the board in place
+    GameState scratch = *game;
+    Move moves[MAX_MOVES];
+    int count = generateLegalMoves(&scratch, moves);
+
+    bool found = false;
+    int bestScore = 0;
+    for (int i = 0; i < count; i++) {
+        GameState child = *game;
+        applyMove(&child, moves[i]);
+
+        TbWdl childWdl;
+        int childPlies;
+        if (!tbProbeDTM(&child, &childWdl, &childPlies)) return false;
+
+        // The child is scored for the opponent
+        TbWdl ours = (TbWdl)-childWdl;
+        int oursPlies = ours == TB_WDL_DRAW ? 0 : childPlies + 1;
+        int score = rootScore(ours, oursPlies);
+        if (!found || score > bestScore) {
+            found = true;
+            bestScore = score;
+            *best = moves[i];
+            *wdl = ours;
+            *plies = oursPlies;
+        }
+    }
+    return found;
+}
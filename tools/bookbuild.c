@@ -0,0 +1,581 @@
+#include "book.h"
+#include "pgn.h"
+#include "platform.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headless opening book builder:
+//   chess_bookbuild [options] -o book.bin games.pgn...
+//
+// The main thread streams games into batches; worker threads replay them
+// and count every (position, move) pair in their own hash table. A full
+// table is sorted and spilled to a run file, and the runs are merged at
+// the end, so memory use stays bounded however many games are read.
+
+#define BATCH_GAMES 256
+#define MERGE_WAYS 64
+#define MAX_RUNS 65536
+
+// Statistics for one move from one position. Runs on disk are arrays of
+// these sorted by key, then move.
+typedef struct {
+    uint64_t key;
+    uint32_t weight;  // 2 per win and 1 per draw for the side that moved
+    uint32_t games;
+    uint16_t move;    // Polyglot encoding
+} BookStat;
+
+typedef struct {
+    const char *output;
+    const char *tempDirectory;
+    int maxPlies;
+    int minGames;
+    int threads;
+    size_t memoryBytes;
+} Options;
+
+typedef struct Batch {
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t offsets[BATCH_GAMES];
+    GameResult results[BATCH_GAMES];
+    int count;
+    struct Batch *next;
+} Batch;
+
+typedef struct {
+    const Options *options;
+
+    // Queue of batches waiting to be replayed
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    Batch *head;
+    Batch *tail;
+    int queued;
+    int maxQueued;
+    bool finished;
+
+    // Run files written so far; guarded by lock
+    char **runs;
+    int runCount;
+    int runSerial;
+    bool failed;
+} Builder;
+
+typedef struct {
+    Builder *builder;
+    pthread_t thread;
+    BookStat *table;
+    size_t capacity;  // Power of two
+    size_t used;
+    long long positions;
+} Worker;
+
+static void usage(void) {
+    printf("Usage: chess_bookbuild [options] -o BOOK.bin GAMES.pgn...\n");
+    printf("  -o FILE    output book in Polyglot format\n");
+    printf("  -p N       plies replayed per game (default 24)\n");
+    printf("  -m N       minimum games for a move to be kept (default 1)\n");
+    printf("  -M MB      memory for move statistics (default 1024)\n");
+    printf("  -t N       worker threads (default: all cores)\n");
+    printf("  -T DIR     directory for temporary run files (default: current directory)\n");
+}
+
+static int compareStats(const void *a, const void *b) {
+    const BookStat *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+// Registers a new run file name; the caller writes the file
+static char *newRunPath(Builder *builder) {
+    char *path = malloc(strlen(builder->options->tempDirectory) + 32);
+    if (!path) return NULL;
+    pthread_mutex_lock(&builder->lock);
+    if (builder->runCount == MAX_RUNS) {
+        pthread_mutex_unlock(&builder->lock);
+        free(path);
+        return NULL;
+    }
+    sprintf(path, "%s/book-run-%06d.tmp", builder->options->tempDirectory, builder->runSerial++);
+    builder->runs[builder->runCount++] = path;
+    pthread_mutex_unlock(&builder->lock);
+    return path;
+}
+
+static bool writeRun(const char *path, const BookStat *stats, size_t count) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(stats, sizeof(BookStat), count, file) == count;
+    return fclose(file) == 0 && ok;
+}
+
+// Sorts the table in place and writes it out as a run
+static void spill(Worker *worker) {
+    size_t count = 0;
+    for (size_t i = 0; i < worker->capacity; i++) {
+        if (worker->table[i].games) worker->table[count++] = worker->table[i];
+    }
+    if (count == 0) return;
+    qsort(worker->table, count, sizeof(BookStat), compareStats);
+
+    char *path = newRunPath(worker->builder);
+    if (!path || !writeRun(path, worker->table, count)) {
+        fprintf(stderr, "Cannot write run file in %s\n", worker->builder->options->tempDirectory);
+        pthread_mutex_lock(&worker->builder->lock);
+        worker->builder->failed = true;
+        pthread_mutex_unlock(&worker->builder->lock);
+    }
+    memset(worker->table, 0, worker->capacity * sizeof(BookStat));
+    worker->used = 0;
+}
+
+static void record(Worker *worker, uint64_t key, uint16_t move, uint32_t weight) {
+    uint64_t hash = (key ^ (move * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+    size_t mask = worker->capacity - 1;
+    for (size_t i = (size_t)(hash >> 32) & mask;; i = (i + 1) & mask) {
+        BookStat *stat = &worker->table[i];
+        if (stat->games == 0) {
+            stat->key = key;
+            stat->move = move;
+            stat->weight = weight;
+            stat->games = 1;
+            // Spill at 3/4 load to keep probe chains short
+            if (++worker->used * 4 >= worker->capacity * 3) spill(worker);
+            return;
+        }
+        if (stat->key == key && stat->move == move) {
+            stat->weight += weight;
+            stat->games++;
+            return;
+        }
+    }
+}
+
+static void replayGame(Worker *worker, const char *movetext, GameResult result) {
+    GameState game = initializeGame();
+    const char *cursor = movetext;
+    const char *end = movetext + strlen(movetext);
+    const char *san;
+    size_t length;
+
+    for (int ply = 0; ply < worker->builder->options->maxPlies; ply++) {
+        if (!pgnNextSan(&cursor, end, &san, &length)) break;
+        Move move;
+        if (!sanToMove(&game, san, length, &move)) break;
+
+        uint32_t weight = 0;
+        if (result == RESULT_DRAW) weight = 1;
+        else if ((result == RESULT_WHITE_WINS) == (game.currentTurn == COLOR_WHITE)) weight = 2;
+
+        record(worker, zobristKey(&game), bookEncodeMove(&game, move), weight);
+        worker->positions++;
+        if (!makeMove(&game, move)) break;
+    }
+}
+
+static Batch *popBatch(Builder *builder) {
+    pthread_mutex_lock(&builder->lock);
+    while (!builder->head && !builder->finished) {
+        pthread_cond_wait(&builder->notEmpty, &builder->lock);
+    }
+    Batch *batch = builder->head;
+    if (batch) {
+        builder->head = batch->next;
+        if (!builder->head) builder->tail = NULL;
+        builder->queued--;
+        pthread_cond_signal(&builder->notFull);
+    }
+    pthread_mutex_unlock(&builder->lock);
+    return batch;
+}
+
+static void pushBatch(Builder *builder, Batch *batch) {
+    pthread_mutex_lock(&builder->lock);
+    while (builder->queued >= builder->maxQueued) {
+        pthread_cond_wait(&builder->notFull, &builder->lock);
+    }
+    batch->next = NULL;
+    if (builder->tail) builder->tail->next = batch;
+    else builder->head = batch;
+    builder->tail = batch;
+    builder->queued++;
+    pthread_cond_signal(&builder->notEmpty);
+    pthread_mutex_unlock(&builder->lock);
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    Batch *batch;
+    while ((batch = popBatch(worker->builder)) != NULL) {
+        for (int i = 0; i < batch->count; i++) {
+            replayGame(worker, batch->text + batch->offsets[i], batch->results[i]);
+        }
+        free(batch->text);
+        free(batch);
+    }
+    spill(worker);
+    return NULL;
+}
+
+static bool addToBatch(Batch *batch, const PgnGame *game) {
+    size_t needed = batch->length + game->movetextLength + 1;
+    if (needed > batch->capacity) {
+        size_t grown = batch->capacity ? batch->capacity * 2 : 65536;
+        while (grown < needed) grown *= 2;
+        char *text = realloc(batch->text, grown);
+        if (!text) return false;
+        batch->text = text;
+        batch->capacity = grown;
+    }
+    batch->offsets[batch->count] = batch->length;
+    batch->results[batch->count] = game->result;
+    memcpy(batch->text + batch->length, game->movetext, game->movetextLength);
+    batch->text[needed - 1] = '\0';
+    batch->length = needed;
+    batch->count++;
+    return true;
+}
+
+// Streams every game of every file to the workers. Returns the number of
+// games queued, or -1 on error.
+static long long readGames(Builder *builder, char **paths, int pathCount) {
+    long long games = 0;
+    Batch *batch = NULL;
+
+    for (int i = 0; i < pathCount; i++) {
+        PgnReader reader;
+        if (!pgnOpen(&reader, paths[i])) {
+            fprintf(stderr, "Cannot open %s\n", paths[i]);
+            free(batch ? batch->text : NULL);
+            free(batch);
+            return -1;
+        }
+        PgnGame game;
+        while (pgnReadGame(&reader, &game)) {
+            // Only finished games from the initial position carry statistics
+            if (game.hasSetup || game.result == RESULT_NONE) continue;
+            if ((!batch && !(batch = calloc(1, sizeof(Batch)))) || !addToBatch(batch, &game)) {
+                fprintf(stderr, "Out of memory\n");
+                pgnClose(&reader);
+                free(batch ? batch->text : NULL);
+                free(batch);
+                return -1;
+            }
+            games++;
+            if (batch->count == BATCH_GAMES) {
+                pushBatch(builder, batch);
+                batch = NULL;
+            }
+            if (games % 1000000 == 0) {
+                fprintf(stderr, "%lld games read\n", games);
+            }
+        }
+        pgnClose(&reader);
+    }
+    if (batch) pushBatch(builder, batch);
+    return games;
+}
+
+// Buffered sequential reader over one run file
+typedef struct {
+    FILE *file;
+    BookStat current;
+} RunReader;
+
+static bool advance(RunReader *run) {
+    return fread(&run->current, sizeof(BookStat), 1, run->file) == 1;
+}
+
+// Min-heap of run readers ordered by their current record
+static void siftDown(RunReader **heap, int count, int index) {
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1, right = left + 1;
+        if (left < count && compareStats(&heap[left]->current, &heap[smallest]->current) < 0) {
+            smallest = left;
+        }
+        if (right < count && compareStats(&heap[right]->current, &heap[smallest]->current) < 0) {
+            smallest = right;
+        }
+        if (smallest == index) return;
+        RunReader *swap = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+typedef bool (*StatSink)(void *context, const BookStat *stat);
+
+// k-way merge of sorted runs; equal (key, move) pairs are summed before
+// being passed to sink, so the sink sees each pair once and in order
+static bool mergeRuns(char **paths, int count, StatSink sink, void *context) {
+    RunReader *runs = calloc((size_t)count, sizeof(RunReader));
+    RunReader **heap = calloc((size_t)count, sizeof(RunReader *));
+    bool ok = runs && heap;
+    int heapCount = 0;
+
+    for (int i = 0; ok && i < count; i++) {
+        runs[i].file = fopen(paths[i], "rb");
+        if (!runs[i].file) {
+            ok = false;
+            break;
+        }
+        setvbuf(runs[i].file, NULL, _IOFBF, 1 << 16);
+        if (advance(&runs[i])) heap[heapCount++] = &runs[i];
+    }
+    for (int i = heapCount / 2 - 1; ok && i >= 0; i--) siftDown(heap, heapCount, i);
+
+    bool pending = false;
+    BookStat merged;
+    while (ok && heapCount > 0) {
+        RunReader *top = heap[0];
+        if (pending && compareStats(&merged, &top->current) == 0) {
+            merged.weight += top->current.weight;
+            merged.games += top->current.games;
+        } else {
+            if (pending && !sink(context, &merged)) ok = false;
+            merged = top->current;
+            pending = true;
+        }
+        if (!advance(top)) heap[0] = heap[--heapCount];
+        siftDown(heap, heapCount, 0);
+    }
+    if (ok && pending && !sink(context, &merged)) ok = false;
+
+    for (int i = 0; runs && i < count; i++) {
+        if (runs[i].file) fclose(runs[i].file);
+    }
+    free(runs);
+    free(heap);
+    return ok;
+}
+
+static bool writeStat(void *context, const BookStat *stat) {
+    return fwrite(stat, sizeof(BookStat), 1, context) == 1;
+}
+
+// Collects the moves of one position, then writes them as book entries
+typedef struct {
+    FILE *file;
+    int minGames;
+    BookStat *moves;
+    int count;
+    int capacity;
+    long long entries;
+    long long positions;
+} BookWriter;
+
+static void putBig(unsigned char *bytes, uint64_t value, int size) {
+    for (int i = size - 1; i >= 0; i--) {
+        bytes[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+static int compareWeight(const void *a, const void *b) {
+    const BookStat *x = a, *y = b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+static bool flushPosition(BookWriter *writer) {
+    if (writer->count == 0) return true;
+    qsort(writer->moves, (size_t)writer->count, sizeof(BookStat), compareWeight);
+
+    // Weights are 16 bits on disk; scale down positions that overflow
+    uint32_t largest = writer->moves[0].weight;
+    for (int i = 0; i < writer->count; i++) {
+        uint64_t weight = writer->moves[i].weight;
+        if (largest > 0xffff) weight = weight * 0xffff / largest;
+        if (weight == 0) weight = 1;
+
+        unsigned char entry[BOOK_ENTRY_SIZE] = { 0 };
+        putBig(entry, writer->moves[i].key, 8);
+        putBig(entry + 8, writer->moves[i].move, 2);
+        putBig(entry + 10, weight, 2);
+        if (fwrite(entry, sizeof(entry), 1, writer->file) != 1) return false;
+        writer->entries++;
+    }
+    writer->positions++;
+    writer->count = 0;
+    return true;
+}
+
+static bool writeEntry(void *context, const BookStat *stat) {
+    BookWriter *writer = context;
+    // Moves that never scored or were rarely played are left out
+    if (stat->weight == 0 || stat->games < (uint32_t)writer->minGames) return true;
+    if (writer->count > 0 && writer->moves[0].key != stat->key && !flushPosition(writer)) {
+        return false;
+    }
+    if (writer->count == writer->capacity) {
+        int grown = writer->capacity ? writer->capacity * 2 : 64;
+        BookStat *moves = realloc(writer->moves, (size_t)grown * sizeof(BookStat));
+        if (!moves) return false;
+        writer->moves = moves;
+        writer->capacity = grown;
+    }
+    writer->moves[writer->count++] = *stat;
+    return true;
+}
+
+static void removeRuns(char **paths, int count) {
+    for (int i = 0; i < count; i++) {
+        remove(paths[i]);
+        free(paths[i]);
+    }
+}
+
+// Merges groups of runs until few enough are left to open at once
+static bool reduceRuns(Builder *builder) {
+    while (builder->runCount > MERGE_WAYS) {
+        int group = builder->runCount < 2 * MERGE_WAYS ? builder->runCount - MERGE_WAYS + 1 : MERGE_WAYS;
+        char *inputs[MERGE_WAYS];
+        memcpy(inputs, builder->runs, (size_t)group * sizeof(char *));
+        builder->runCount -= group;
+        memmove(builder->runs, builder->runs + group, (size_t)builder->runCount * sizeof(char *));
+
+        char *path = newRunPath(builder);
+        FILE *file = path ? fopen(path, "wb") : NULL;
+        bool ok = file && mergeRuns(inputs, group, writeStat, file);
+        if (file && fclose(file) != 0) ok = false;
+        removeRuns(inputs, group);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+static bool writeBook(Builder *builder) {
+    if (!reduceRuns(builder)) {
+        fprintf(stderr, "Failed to merge run files\n");
+        return false;
+    }
+
+    BookWriter writer = { 0 };
+    writer.minGames = builder->options->minGames;
+    writer.file = fopen(builder->options->output, "wb");
+    if (!writer.file) {
+        fprintf(stderr, "Cannot write %s\n", builder->options->output);
+        return false;
+    }
+    bool ok = mergeRuns(builder->runs, builder->runCount, writeEntry, &writer) &&
+              flushPosition(&writer);
+    if (fclose(writer.file) != 0) ok = false;
+    free(writer.moves);
+
+    if (ok) {
+        printf("Book: %lld entries for %lld positions\n", writer.entries, writer.positions);
+    } else {
+        fprintf(stderr, "Failed to write %s\n", builder->options->output);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    Options options = { NULL, ".", 24, 1, platformCpuCount(), (size_t)1024 << 20 };
+    char **paths = calloc((size_t)argc, sizeof(char *));
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            options.maxPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            options.minGames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            char *end;
+            long megabytes = strtol(argv[++i], &end, 10);
+            // Left at zero, and so rejected below, unless it fits in a size_t
+            options.memoryBytes = 0;
+            if (end != argv[i] && *end == '\0' && megabytes >= 1 &&
+                (unsigned long)megabytes <= SIZE_MAX >> 20) {
+                options.memoryBytes = (size_t)megabytes << 20;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            options.tempDirectory = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            paths[pathCount++] = argv[i];
+        }
+    }
+    if (!options.output || pathCount == 0 || options.maxPlies < 1 ||
+        options.minGames < 1 || options.threads < 1 || options.memoryBytes == 0) {
+        usage();
+        return 1;
+    }
+
+    // Each worker gets an equal share of the memory, rounded down to a
+    // power of two entries
+    size_t capacity = 1024;
+    while (capacity * 2 * sizeof(BookStat) <= options.memoryBytes / (size_t)options.threads) {
+        capacity *= 2;
+    }
+
+    Builder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.options = &options;
+    builder.maxQueued = 2 * options.threads;
+    builder.runs = calloc(MAX_RUNS, sizeof(char *));
+    pthread_mutex_init(&builder.lock, NULL);
+    pthread_cond_init(&builder.notEmpty, NULL);
+    pthread_cond_init(&builder.notFull, NULL);
+
+    Worker *workers = calloc((size_t)options.threads, sizeof(Worker));
+    int started = 0;
+    for (int i = 0; workers && builder.runs && i < options.threads; i++) {
+        workers[i].builder = &builder;
+        workers[i].capacity = capacity;
+        workers[i].table = calloc(capacity, sizeof(BookStat));
+        if (!workers[i].table) break;
+        if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) {
+            free(workers[i].table);
+            break;
+        }
+        started++;
+    }
+
+    long long games = -1;
+    if (started > 0) games = readGames(&builder, paths, pathCount);
+
+    pthread_mutex_lock(&builder.lock);
+    builder.finished = true;
+    pthread_cond_broadcast(&builder.notEmpty);
+    pthread_mutex_unlock(&builder.lock);
+
+    long long positions = 0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        positions += workers[i].positions;
+        free(workers[i].table);
+    }
+
+    bool ok = started > 0 && games >= 0 && !builder.failed;
+    if (started == 0) fprintf(stderr, "Cannot start worker threads\n");
+    if (ok) {
+        printf("Replayed %lld games, %lld positions, %d run files\n",
+               games, positions, builder.runCount);
+        ok = writeBook(&builder);
+    }
+
+    removeRuns(builder.runs, builder.runCount);
+    pthread_cond_destroy(&builder.notFull);
+    pthread_cond_destroy(&builder.notEmpty);
+    pthread_mutex_destroy(&builder.lock);
+    free(builder.runs);
+    free(workers);
+    free(paths);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+#include "fen.h"
+#include "packed.h"
+#include "platform.h"
+#include "search.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Self-play training data generator:
+//   chess_datagen [options] -o OUTPUT.pos
+//
+// Every thread plays its own games with searchLocal at a fixed node count,
+// starting from the initial position or a random line of -r plies. Quiet
+// positions (not in check, best move not a capture, no mate in sight) are
+// kept with the search score and, once the game ends, its result. Each
+// thread collects records in a buffer of its own and appends whole
+// buffers to the output, so the one lock is taken once per WRITE_BATCH
+// positions.
+
+#define WRITE_BATCH 4096
+#define MAX_GAME_PLIES 1024
+#define REPORT_INTERVAL_MS 10000
+
+// A game is adjudicated as won once the score stays this high
+#define WIN_SCORE 1500
+#define WIN_PLIES 8
+
+typedef struct {
+    long long nodes;
+    int randomPlies;
+    int maxPlies;
+    long long games;
+
+    pthread_mutex_t lock;
+    FILE *output;
+    bool writeFailed;
+    long long nextGame;
+    long long positions;
+    long long finishedGames;
+    long long start;
+    long long lastReport;
+} Generator;
+
+typedef struct {
+    Generator *generator;
+    pthread_t thread;
+    uint64_t seed;
+    int count;
+    PackedPosition buffer[WRITE_BATCH];
+    // Positions of the game in progress; their result is not known yet
+    int gameCount;
+    PackedPosition game[MAX_GAME_PLIES];
+} Worker;
+
+static void usage(void) {
+    printf("Usage: chess_datagen [options] -o OUTPUT.pos\n");
+    printf("  -g N       games to play (default 10000)\n");
+    printf("  -n N       nodes per move (default 5000)\n");
+    printf("  -r N       random opening plies (default 8)\n");
+    printf("  -m N       adjudicate a draw after N plies (default 400)\n");
+    printf("  -t N       threads (default: all cores)\n");
+    printf("  -H MB      shared hash size (default 64)\n");
+    printf("  -s SEED    random seed (default: from the clock)\n");
+    printf("Positions are appended to OUTPUT.\n");
+}
+
+static uint64_t nextRandom(uint64_t *seed) {
+    // xorshift64*
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 0x2545f4914f6cdd1dULL;
+}
+
+static void flushBuffer(Worker *worker) {
+    Generator *generator = worker->generator;
+    pthread_mutex_lock(&generator->lock);
+    if (fwrite(worker->buffer, sizeof(PackedPosition), (size_t)worker->count, generator->output) !=
+        (size_t)worker->count) {
+        generator->writeFailed = true;
+    }
+    generator->positions += worker->count;
+
+    long long now = platformMilliseconds();
+    if (now - generator->lastReport >= REPORT_INTERVAL_MS) {
+        double hours = (double)(now - generator->start) / 3600000.0;
+        fprintf(stderr, "%lld games, %lld positions, %.0f positions/hour\n",
+                generator->finishedGames, generator->positions, generator->positions / hours);
+        generator->lastReport = now;
+    }
+    pthread_mutex_unlock(&generator->lock);
+    worker->count = 0;
+}
+
+// Labels the positions of the finished game and moves them to the buffer
+static void keepGame(Worker *worker, GameResult result) {
+    for (int i = 0; i < worker->gameCount; i++) {
+        worker->game[i].result = (uint8_t)result;
+        worker->buffer[worker->count++] = worker->game[i];
+        if (worker->count == WRITE_BATCH) flushBuffer(worker);
+    }
+    worker->gameCount = 0;
+}
+
+// Bare kings, or a single minor piece against a bare king
+static bool insufficientMaterial(const GameState *game) {
+    int minors = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            PieceType type = PIECE_TYPE(game->board[SQUARE(x, y)]);
+            if (type == KNIGHT || type == BISHOP) minors++;
+            else if (type != EMPTY && type != KING) return false;
+        }
+    }
+    return minors <= 1;
+}
+
+static bool isCapture(const GameState *game, Move move) {
+    return game->board[MOVE_TO_SQUARE(move)] != EMPTY || MOVE_KIND(move) == MOVE_EN_PASSANT;
+}
+
+static GameResult winFor(ColorPieces color) {
+    return color == COLOR_WHITE ? RESULT_WHITE_WINS : RESULT_BLACK_WINS;
+}
+
+// Plays one game, collecting its quiet positions. Returns RESULT_NONE for
+// games that cannot be finished, whose positions are dropped.
+static GameResult playGame(Worker *worker) {
+    const Generator *generator = worker->generator;
+    GameState game = initializeGame();
+    uint64_t keys[MAX_GAME_PLIES];
+    int keyCount = 0;
+    int quietPlies = 0;  // Since the last capture or pawn move
+    int winningPlies = 0;
+    ColorPieces winner = COLOR_NONE;
+    SearchLimits limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.nodes = generator->nodes;
+    worker->gameCount = 0;
+
+    for (int ply = 0; ply < generator->maxPlies && ply < MAX_GAME_PLIES; ply++) {
+        Move moves[MAX_MOVES];
+        int count = generateLegalMoves(&game, moves);
+        ColorPieces opponent = game.currentTurn == COLOR_WHITE ? COLOR_BLACK : COLOR_WHITE;
+        if (count == 0) return game.isCheck ? winFor(opponent) : RESULT_DRAW;
+
+        uint64_t key = zobristKey(&game);
+        int repeats = 0;
+        for (int i = 0; i < keyCount; i++) repeats += keys[i] == key;
+        if (repeats >= 2 || quietPlies >= 100 || insufficientMaterial(&game)) return RESULT_DRAW;
+        keys[keyCount++] = key;
+
+        Move move;
+        if (ply < generator->randomPlies) {
+            move = moves[nextRandom(&worker->seed) % (uint64_t)count];
+        } else {
+            int score;
+            if (!searchLocal(&game, keys, keyCount - 1, &limits, &move, &score)) return RESULT_NONE;
+
+            if (score >= WIN_SCORE || score <= -WIN_SCORE) {
+                ColorPieces leader = score > 0 ? game.currentTurn : opponent;
+                winningPlies = leader == winner ? winningPlies + 1 : 1;
+                winner = leader;
+                if (winningPlies >= WIN_PLIES) return winFor(winner);
+            } else {
+                winningPlies = 0;
+            }
+
+            if (!game.isCheck && !isCapture(&game, move) &&
+                MOVE_KIND(move) != MOVE_PROMOTION && score < SCORE_MATE_BOUND &&
+                score > -SCORE_MATE_BOUND) {
+                PackedInfo info = { quietPlies, ply / 2 + 1,
+                                    game.currentTurn == COLOR_WHITE ? score : -score, RESULT_NONE };
+                packPosition(&game, &info, &worker->game[worker->gameCount++]);
+            }
+        }
+
+        Piece piece = game.board[MOVE_FROM_SQUARE(move)];
+        quietPlies = (isCapture(&game, move) || PIECE_TYPE(piece) == PAWN) ? 0 : quietPlies + 1;
+        applyMove(&game, move);
+    }
+    return RESULT_DRAW;
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    Generator *generator = worker->generator;
+    for (;;) {
+        pthread_mutex_lock(&generator->lock);
+        bool more = generator->nextGame < generator->games && !generator->writeFailed;
+        generator->nextGame++;
+        pthread_mutex_unlock(&generator->lock);
+        if (!more) break;
+
+        GameResult result = playGame(worker);
+        if (result != RESULT_NONE) keepGame(worker, result);
+
+        pthread_mutex_lock(&generator->lock);
+        generator->finishedGames++;
+        pthread_mutex_unlock(&generator->lock);
+    }
+    if (worker->count > 0) flushBuffer(worker);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    static Generator generator;
+    generator.nodes = 5000;
+    generator.randomPlies = 8;
+    generator.maxPlies = 400;
+    generator.games = 10000;
+    const char *outputPath = NULL;
+    int threads = platformCpuCount();
+    int hashMB = 64;
+    uint64_t seed = (uint64_t)platformMilliseconds();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outputPath = argv[++i];
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) generator.games = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) generator.nodes = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) generator.randomPlies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) generator.maxPlies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) hashMB = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (!outputPath || generator.nodes < 1 || generator.randomPlies < 0 || generator.maxPlies < 1 ||
+        threads < 1 || hashMB < 1) {
+        usage();
+        return 1;
+    }
+
+    if (!searchSetHash((size_t)hashMB)) {
+        fprintf(stderr, "Cannot allocate %d MB of hash\n", hashMB);
+        return 1;
+    }
+    generator.output = fopen(outputPath, "ab");
+    if (!generator.output) {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+    pthread_mutex_init(&generator.lock, NULL);
+    generator.start = generator.lastReport = platformMilliseconds();
+
+    Worker *workers = calloc((size_t)threads, sizeof(Worker));
+    if (!workers) return 1;
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i].generator = &generator;
+        // Any nonzero seed works; threads get well separated ones
+        workers[i].seed = (seed + (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ULL) | 1;
+        if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) break;
+        started++;
+    }
+    // The main thread plays too if threads could not be started
+    if (started == 0) workerMain(&workers[0]);
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+    bool ok = !generator.writeFailed && fclose(generator.output) == 0;
+    long long elapsed = platformMilliseconds() - generator.start;
+    printf("%lld games, %lld positions in %.1f s\n", generator.finishedGames, generator.positions,
+           (double)elapsed / 1000.0);
+    if (!ok) fprintf(stderr, "Cannot write %s\n", outputPath);
+
+    free(workers);
+    pthread_mutex_destroy(&generator.lock);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+#include "fen.h"
+#include "platform.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headless EPD validator and annotator:
+//   chess_epdcheck [-t threads] [-o output.epd] [input.epd...]
+//
+// Every FEN or EPD line is checked and written back with two extra
+// operations: "status" (ok, check, checkmate, stalemate, illegal or
+// invalid) and "legalmoves". FEN move counters become the hmvc and fmvn
+// operations. Lines are read in batches that worker threads annotate in
+// any order; the writer thread puts them back in input order through a
+// window of REORDER_WINDOW batches, which also bounds memory use.
+
+#define BATCH_LINES 4096
+#define REORDER_WINDOW 64
+#define MAX_LINE 4096
+
+typedef enum {
+    STATUS_OK,
+    STATUS_CHECK,
+    STATUS_CHECKMATE,
+    STATUS_STALEMATE,
+    STATUS_ILLEGAL,
+    STATUS_INVALID,
+    STATUS_COUNT
+} Status;
+
+static const char *statusNames[STATUS_COUNT] = {
+    "ok", "check", "checkmate", "stalemate", "illegal", "invalid"
+};
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+typedef enum { SLOT_EMPTY, SLOT_READ, SLOT_DONE } SlotState;
+
+typedef struct {
+    SlotState state;
+    Buffer input;   // Lines, each NUL terminated
+    size_t offsets[BATCH_LINES];
+    int count;
+    Buffer output;
+    long long statusCounts[STATUS_COUNT];
+} Batch;
+
+// Batch n lives in slots[n % REORDER_WINDOW]. The reader fills slots up
+// to REORDER_WINDOW batches ahead of the writer, workers claim them in
+// sequence, and the writer drains them in sequence.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Batch slots[REORDER_WINDOW];
+    long long nextRead;
+    long long nextProcess;
+    long long nextWrite;
+    bool finished;  // No more batches will be read
+
+    FILE *output;
+    bool writeFailed;
+    long long statusCounts[STATUS_COUNT];
+} Pipeline;
+
+static void usage(void) {
+    printf("Usage: chess_epdcheck [options] [POSITIONS.epd...]\n");
+    printf("  -o FILE    annotated output (default: standard output)\n");
+    printf("  -t N       worker threads (default: all cores)\n");
+    printf("Reads standard input when no file is given.\n");
+}
+
+static bool append(Buffer *buffer, const char *text, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t grown = buffer->capacity ? buffer->capacity : 65536;
+        while (grown < buffer->length + length) grown *= 2;
+        char *data = realloc(buffer->data, grown);
+        if (!data) return false;
+        buffer->data = data;
+        buffer->capacity = grown;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    return true;
+}
+
+static bool appendText(Buffer *buffer, const char *text) {
+    return append(buffer, text, strlen(text));
+}
+
+static int countPieces(const GameState *game, ColorPieces color, PieceType type) {
+    int count = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (piece != EMPTY && PIECE_COLOR(piece) == color && (type == EMPTY || PIECE_TYPE(piece) == type)) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// gameFromFEN rejects broken boards; this adds what cannot arise in a game
+static bool isLegalPosition(GameState *game) {
+    ColorPieces opponent = game->currentTurn == COLOR_WHITE ? COLOR_BLACK : COLOR_WHITE;
+    if (isInCheck(game, opponent)) return false;
+    for (ColorPieces color = COLOR_WHITE; color <= COLOR_BLACK; color++) {
+        if (countPieces(game, color, EMPTY) > 16 || countPieces(game, color, PAWN) > 8) return false;
+    }
+    return true;
+}
+
+static Status classify(GameState *game, int *legalMoves) {
+    Move moves[MAX_MOVES];
+    *legalMoves = 0;
+    if (!isLegalPosition(game)) return STATUS_ILLEGAL;
+
+    *legalMoves = generateLegalMoves(game, moves);
+    if (isKingCheckmated(game)) return STATUS_CHECKMATE;
+    if (isInCheck(game, game->currentTurn)) return STATUS_CHECK;
+    // Stalemate: not in check, yet no legal move
+    if (*legalMoves == 0) return STATUS_STALEMATE;
+    return STATUS_OK;
+}
+
+static bool isNumber(const char *text, size_t length) {
+    if (length == 0) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (!isdigit((unsigned char)text[i])) return false;
+    }
+    return true;
+}
+
+// Splits off the next whitespace separated field
+static const char *nextField(const char **cursor, size_t *length) {
+    const char *p = *cursor;
+    while (isspace((unsigned char)*p)) p++;
+    const char *start = p;
+    while (*p && !isspace((unsigned char)*p)) p++;
+    *length = (size_t)(p - start);
+    *cursor = p;
+    return start;
+}
+
+static bool annotateLine(const char *line, Buffer *out, long long *statusCounts) {
+    const char *cursor = line;
+    size_t length;
+    nextField(&cursor, &length);
+    if (length == 0) return appendText(out, "\n");  // Blank lines stay blank
+
+    int legalMoves = 0;
+    GameState game;
+    Status status = gameFromFEN(line, &game) ? classify(&game, &legalMoves) : STATUS_INVALID;
+    statusCounts[status]++;
+
+    char annotation[64];
+    if (status == STATUS_INVALID) {
+        sprintf(annotation, " status %s;\n", statusNames[status]);
+        return appendText(out, line) && appendText(out, annotation);
+    }
+
+    // The four position fields, as given
+    cursor = line;
+    const char *fields = cursor;
+    for (int i = 0; i < 4; i++) nextField(&cursor, &length);
+    const char *fieldsEnd = cursor;
+    while (isspace((unsigned char)*fields)) fields++;
+    if (!append(out, fields, (size_t)(fieldsEnd - fields))) return false;
+
+    // FEN move counters become EPD operations
+    const char *rest = cursor;
+    size_t halfmoveLength, fullmoveLength;
+    const char *halfmove = nextField(&cursor, &halfmoveLength);
+    const char *fullmove = nextField(&cursor, &fullmoveLength);
+    if (isNumber(halfmove, halfmoveLength) && isNumber(fullmove, fullmoveLength) &&
+        halfmoveLength < 10 && fullmoveLength < 10) {
+        char counters[48];
+        sprintf(counters, " hmvc %.*s; fmvn %.*s;", (int)halfmoveLength, halfmove,
+                (int)fullmoveLength, fullmove);
+        if (!appendText(out, counters)) return false;
+        rest = cursor;
+    }
+
+    // Operations already present are kept
+    while (isspace((unsigned char)*rest)) rest++;
+    size_t restLength = strlen(rest);
+    while (restLength > 0 && isspace((unsigned char)rest[restLength - 1])) restLength--;
+    if (restLength > 0 && (!appendText(out, " ") || !append(out, rest, restLength))) return false;
+
+    sprintf(annotation, " status %s; legalmoves %d;\n", statusNames[status], legalMoves);
+    return appendText(out, annotation);
+}
+
+static void *workerMain(void *arg) {
+    Pipeline *pipeline = arg;
+    pthread_mutex_lock(&pipeline->lock);
+    for (;;) {
+        while (pipeline->nextProcess == pipeline->nextRead && !pipeline->finished) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        if (pipeline->nextProcess == pipeline->nextRead) break;
+        Batch *batch = &pipeline->slots[pipeline->nextProcess++ % REORDER_WINDOW];
+        pthread_mutex_unlock(&pipeline->lock);
+
+        bool ok = true;
+        batch->output.length = 0;
+        memset(batch->statusCounts, 0, sizeof(batch->statusCounts));
+        for (int i = 0; i < batch->count && ok; i++) {
+            ok = annotateLine(batch->input.data + batch->offsets[i], &batch->output, batch->statusCounts);
+        }
+
+        pthread_mutex_lock(&pipeline->lock);
+        if (!ok) pipeline->writeFailed = true;
+        batch->state = SLOT_DONE;
+        pthread_cond_broadcast(&pipeline->changed);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+static void *writerMain(void *arg) {
+    Pipeline *pipeline = arg;
+    pthread_mutex_lock(&pipeline->lock);
+    for (;;) {
+        Batch *batch = &pipeline->slots[pipeline->nextWrite % REORDER_WINDOW];
+        while (batch->state != SLOT_DONE && !(pipeline->finished && pipeline->nextWrite == pipeline->nextRead)) {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        if (batch->state != SLOT_DONE) break;
+        pthread_mutex_unlock(&pipeline->lock);
+
+        bool ok = fwrite(batch->output.data, 1, batch->output.length, pipeline->output) ==
+                  batch->output.length;
+
+        pthread_mutex_lock(&pipeline->lock);
+        if (!ok) pipeline->writeFailed = true;
+        for (int i = 0; i < STATUS_COUNT; i++) pipeline->statusCounts[i] += batch->statusCounts[i];
+        batch->state = SLOT_EMPTY;
+        pipeline->nextWrite++;
+        pthread_cond_broadcast(&pipeline->changed);
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+    return NULL;
+}
+
+// Waits for the next slot to be free, hands it back to be filled
+static Batch *claimSlot(Pipeline *pipeline) {
+    pthread_mutex_lock(&pipeline->lock);
+    while (pipeline->nextRead - pipeline->nextWrite >= REORDER_WINDOW) {
+        pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+    }
+    Batch *batch = &pipeline->slots[pipeline->nextRead % REORDER_WINDOW];
+    pthread_mutex_unlock(&pipeline->lock);
+    batch->input.length = 0;
+    batch->count = 0;
+    return batch;
+}
+
+static void publishSlot(Pipeline *pipeline, Batch *batch) {
+    pthread_mutex_lock(&pipeline->lock);
+    batch->state = SLOT_READ;
+    pipeline->nextRead++;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+// Feeds every line of file to the pipeline; batch carries over between files
+static bool readLines(Pipeline *pipeline, FILE *file, Batch **batch) {
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' && !feof(file)) {
+            // Too long to be a position: skip the rest, keep the line slot
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n') {}
+            strcpy(line, "-");
+            length = 1;
+        }
+        line[length] = '\0';
+
+        if (!*batch) *batch = claimSlot(pipeline);
+        (*batch)->offsets[(*batch)->count++] = (*batch)->input.length;
+        if (!append(&(*batch)->input, line, length + 1)) return false;
+        if ((*batch)->count == BATCH_LINES) {
+            publishSlot(pipeline, *batch);
+            *batch = NULL;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *outputPath = NULL;
+    int threads = platformCpuCount();
+    int firstInput = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            firstInput = i;
+            break;
+        }
+    }
+    if (threads < 1) {
+        usage();
+        return 1;
+    }
+
+    static Pipeline pipeline;
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    pipeline.output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!pipeline.output) {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+
+    pthread_t writer;
+    pthread_t *workers = calloc((size_t)threads, sizeof(pthread_t));
+    int started = 0;
+    bool ok = workers && pthread_create(&writer, NULL, writerMain, &pipeline) == 0;
+    for (int i = 0; ok && i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, workerMain, &pipeline) != 0) break;
+        started++;
+    }
+    if (ok && started == 0) {
+        fprintf(stderr, "Cannot start worker threads\n");
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.finished = true;
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+        pthread_join(writer, NULL);
+        ok = false;
+    }
+
+    long long start = platformMilliseconds();
+    if (ok) {
+        Batch *batch = NULL;
+        if (firstInput == argc) {
+            ok = readLines(&pipeline, stdin, &batch);
+        }
+        for (int i = firstInput; ok && i < argc; i++) {
+            FILE *file = fopen(argv[i], "r");
+            if (!file) {
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                ok = false;
+                break;
+            }
+            ok = readLines(&pipeline, file, &batch);
+            fclose(file);
+        }
+        if (batch) publishSlot(&pipeline, batch);
+
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.finished = true;
+        pthread_cond_broadcast(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+        for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+        pthread_join(writer, NULL);
+    }
+
+    if (fflush(pipeline.output) != 0) pipeline.writeFailed = true;
+    if (outputPath && fclose(pipeline.output) != 0) pipeline.writeFailed = true;
+    if (pipeline.writeFailed) {
+        fprintf(stderr, "Cannot write output\n");
+        ok = false;
+    }
+
+    long long total = 0;
+    for (int i = 0; i < STATUS_COUNT; i++) total += pipeline.statusCounts[i];
+    fprintf(stderr, "%lld positions in %.3f s:", total, (double)(platformMilliseconds() - start) / 1000.0);
+    for (int i = 0; i < STATUS_COUNT; i++) {
+        fprintf(stderr, " %s %lld%s", statusNames[i], pipeline.statusCounts[i], i + 1 < STATUS_COUNT ? "," : "\n");
+    }
+
+    for (int i = 0; i < REORDER_WINDOW; i++) {
+        free(pipeline.slots[i].input.data);
+        free(pipeline.slots[i].output.data);
+    }
+    free(workers);
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.lock);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,410 @@
+#include "fen.h"
+#include "gamedb.h"
+#include "movecodec.h"
+#include "pgn.h"
+#include "platform.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Game database builder and query tool:
+//   chess_gamedb [-t threads] -o GAMES.gdb GAMES.pgn...
+//   chess_gamedb -d GAMES.gdb [-f FEN] [-l limit]
+//
+// Building splits every PGN file into one chunk per thread. Workers claim
+// chunks, replay their games and collect the moves plus one index entry
+// per distinct position of each game, then sort the entries of the
+// chunk. Game ids follow file order, so the sorted chunks are merged
+// straight into the final index. Games with a [FEN] setup are skipped.
+
+#define MAX_THREADS 256
+#define WRITE_BUFFER 65536
+
+typedef struct {
+    uint64_t key;
+    uint32_t game;  // Within the chunk
+} Entry;
+
+typedef struct {
+    PgnReader reader;
+    Entry *entries;
+    size_t entryCount, entryCapacity;
+    unsigned char *moves;  // Encoded games back to back
+    size_t moveBytes, moveCapacity;
+    uint32_t *gameBytes;
+    uint8_t *results;
+    size_t gameCount, gameCapacity, resultCapacity;
+    size_t skipped;
+    bool failed;  // Out of memory
+    uint64_t firstGame;  // Id of the chunk's first game, set once all are read
+} Chunk;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Chunk *chunks;
+    int chunkCount;
+    int nextChunk;
+} Builder;
+
+// Little endian output through a buffer
+typedef struct {
+    FILE *file;
+    unsigned char data[WRITE_BUFFER];
+    size_t length;
+    bool failed;
+} Writer;
+
+static void usage(void) {
+    printf("Usage: chess_gamedb [-t threads] -o GAMES.gdb GAMES.pgn...\n");
+    printf("       chess_gamedb -d GAMES.gdb [-f FEN] [-l limit]\n");
+    printf("  -t N       threads for building (default: all cores)\n");
+    printf("  -f FEN     position to look up (default: the initial position)\n");
+    printf("  -l N       games to list (default 20)\n");
+}
+
+static bool reserve(void **data, size_t *capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) return true;
+    size_t grown = *capacity ? *capacity : 4096;
+    while (grown < needed) grown *= 2;
+    void *resized = realloc(*data, grown * size);
+    if (!resized) return false;
+    *data = resized;
+    *capacity = grown;
+    return true;
+}
+
+static int compareEntries(const void *a, const void *b) {
+    const Entry *x = a, *y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->game < y->game ? -1 : x->game > y->game;
+}
+
+// Replays the game, storing its moves and an entry for each new position
+static bool addGame(Chunk *chunk, const Move *moves, int plies, GameResult result) {
+    uint32_t game = (uint32_t)chunk->gameCount;
+    size_t games = chunk->gameCount + 1;
+    if (!reserve((void **)&chunk->moves, &chunk->moveCapacity, chunk->moveBytes + MOVE_CODEC_BOUND(plies), 1) ||
+        !reserve((void **)&chunk->entries, &chunk->entryCapacity, chunk->entryCount + (size_t)plies + 1, sizeof(Entry)) ||
+        !reserve((void **)&chunk->gameBytes, &chunk->gameCapacity, games, sizeof(uint32_t)) ||
+        !reserve((void **)&chunk->results, &chunk->resultCapacity, games, sizeof(uint8_t))) {
+        return false;
+    }
+
+    GameState state = initializeGame();
+    size_t firstEntry = chunk->entryCount;
+    for (int ply = 0; ply <= plies; ply++) {
+        uint64_t key = zobristKey(&state);
+        bool seen = false;
+        for (size_t i = firstEntry; i < chunk->entryCount && !seen; i++) {
+            seen = chunk->entries[i].key == key;
+        }
+        if (!seen) chunk->entries[chunk->entryCount++] = (Entry){ key, game };
+        if (ply == plies) break;
+
+        applyMove(&state, moves[ply]);
+    }
+
+    GameState start = initializeGame();
+    size_t length = moveCodecEncode(&start, moves, plies, true, chunk->moves + chunk->moveBytes);
+    if (length == 0) return false;
+    chunk->moveBytes += length;
+    chunk->gameBytes[game] = (uint32_t)length;
+    chunk->results[game] = (uint8_t)result;
+    chunk->gameCount = games;
+    return true;
+}
+
+static void readChunk(Chunk *chunk) {
+    Move moves[PGN_MAX_PLIES];
+    PgnGame pgn;
+    GameState game;
+    while (pgnReadGame(&chunk->reader, &pgn)) {
+        int plies = pgn.hasSetup ? -1 : pgnDecodeGame(&pgn, &game, moves, PGN_MAX_PLIES);
+        if (plies < 0) {
+            chunk->skipped++;
+            continue;
+        }
+        if (!addGame(chunk, moves, plies, pgn.result)) {
+            chunk->failed = true;
+            return;
+        }
+    }
+    qsort(chunk->entries, chunk->entryCount, sizeof(Entry), compareEntries);
+}
+
+static void *workerMain(void *arg) {
+    Builder *builder = arg;
+    for (;;) {
+        pthread_mutex_lock(&builder->lock);
+        int index = builder->nextChunk++;
+        pthread_mutex_unlock(&builder->lock);
+        if (index >= builder->chunkCount) break;
+        readChunk(&builder->chunks[index]);
+    }
+    return NULL;
+}
+
+static void writeLittle(Writer *out, uint64_t value, int size) {
+    if (out->length + (size_t)size > sizeof(out->data)) {
+        if (fwrite(out->data, 1, out->length, out->file) != out->length) out->failed = true;
+        out->length = 0;
+    }
+    for (int i = 0; i < size; i++) {
+        out->data[out->length++] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void flushWriter(Writer *out) {
+    if (fwrite(out->data, 1, out->length, out->file) != out->length) out->failed = true;
+    out->length = 0;
+}
+
+// Heap of chunk cursors for the index merge, smallest entry on top
+typedef struct {
+    Chunk *chunks;
+    size_t *cursors;
+    int *heap;
+    int size;
+} Merge;
+
+static bool mergeBefore(const Merge *merge, int a, int b) {
+    const Entry *x = &merge->chunks[a].entries[merge->cursors[a]];
+    const Entry *y = &merge->chunks[b].entries[merge->cursors[b]];
+    if (x->key != y->key) return x->key < y->key;
+    return merge->chunks[a].firstGame + x->game < merge->chunks[b].firstGame + y->game;
+}
+
+static void siftDown(Merge *merge, int index) {
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1, right = left + 1;
+        if (left < merge->size && mergeBefore(merge, merge->heap[left], merge->heap[smallest])) smallest = left;
+        if (right < merge->size && mergeBefore(merge, merge->heap[right], merge->heap[smallest])) smallest = right;
+        if (smallest == index) return;
+        int swap = merge->heap[index];
+        merge->heap[index] = merge->heap[smallest];
+        merge->heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+static bool writeDatabase(const char *path, Chunk *chunks, int chunkCount,
+                          uint64_t games, uint64_t moveBytes, uint64_t entryCount) {
+    static Writer out;
+    out.file = fopen(path, "wb");
+    if (!out.file) return false;
+
+    for (int i = 0; i < 8; i++) writeLittle(&out, (unsigned char)GAMEDB_MAGIC[i], 1);
+    writeLittle(&out, GAMEDB_VERSION, 4);
+    writeLittle(&out, 0, 4);
+    writeLittle(&out, games, 8);
+    writeLittle(&out, moveBytes, 8);
+    writeLittle(&out, entryCount, 8);
+    for (int i = 40; i < GAMEDB_HEADER_SIZE; i++) writeLittle(&out, 0, 1);
+
+    uint64_t offset = 0;
+    for (int c = 0; c < chunkCount; c++) {
+        for (size_t g = 0; g < chunks[c].gameCount; g++) {
+            writeLittle(&out, offset, 8);
+            offset += chunks[c].gameBytes[g];
+        }
+    }
+    writeLittle(&out, offset, 8);
+    for (int c = 0; c < chunkCount; c++) {
+        for (size_t g = 0; g < chunks[c].gameCount; g++) writeLittle(&out, chunks[c].results[g], 1);
+    }
+    for (int c = 0; c < chunkCount; c++) {
+        for (size_t m = 0; m < chunks[c].moveBytes; m++) writeLittle(&out, chunks[c].moves[m], 1);
+    }
+
+    Merge merge = { chunks, calloc((size_t)chunkCount, sizeof(size_t)), calloc((size_t)chunkCount, sizeof(int)), 0 };
+    bool ok = merge.cursors && merge.heap;
+    for (int c = 0; ok && c < chunkCount; c++) {
+        if (chunks[c].entryCount > 0) merge.heap[merge.size++] = c;
+    }
+    for (int i = merge.size / 2 - 1; ok && i >= 0; i--) siftDown(&merge, i);
+    while (ok && merge.size > 0) {
+        int c = merge.heap[0];
+        const Entry *entry = &chunks[c].entries[merge.cursors[c]];
+        writeLittle(&out, entry->key, 8);
+        writeLittle(&out, chunks[c].firstGame + entry->game, 4);
+        if (++merge.cursors[c] == chunks[c].entryCount) merge.heap[0] = merge.heap[--merge.size];
+        siftDown(&merge, 0);
+    }
+    free(merge.cursors);
+    free(merge.heap);
+
+    flushWriter(&out);
+    if (fclose(out.file) != 0) out.failed = true;
+    return ok && !out.failed;
+}
+
+static int build(const char *output, char **paths, int pathCount, int threads) {
+    PgnReader *readers = calloc((size_t)pathCount, sizeof(PgnReader));
+    Chunk *chunks = calloc((size_t)pathCount * (size_t)threads, sizeof(Chunk));
+    if (!readers || !chunks) return 1;
+
+    int opened = 0;
+    for (; opened < pathCount; opened++) {
+        if (!pgnOpen(&readers[opened], paths[opened])) {
+            fprintf(stderr, "Cannot read %s\n", paths[opened]);
+            break;
+        }
+        for (int t = 0; t < threads; t++) {
+            pgnSplit(&readers[opened], t, threads, &chunks[opened * threads + t].reader);
+        }
+    }
+
+    int status = 1;
+    if (opened == pathCount) {
+        long long start = platformMilliseconds();
+        Builder builder = { .chunks = chunks, .chunkCount = pathCount * threads };
+        pthread_mutex_init(&builder.lock, NULL);
+        pthread_t workers[MAX_THREADS];
+        int started = 0;
+        for (; started < threads; started++) {
+            if (pthread_create(&workers[started], NULL, workerMain, &builder) != 0) break;
+        }
+        if (started == 0) workerMain(&builder);
+        for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+        pthread_mutex_destroy(&builder.lock);
+
+        uint64_t games = 0, moveBytes = 0, entryCount = 0, skipped = 0;
+        bool failed = false;
+        for (int c = 0; c < builder.chunkCount; c++) {
+            chunks[c].firstGame = games;
+            games += chunks[c].gameCount;
+            moveBytes += chunks[c].moveBytes;
+            entryCount += chunks[c].entryCount;
+            skipped += chunks[c].skipped;
+            failed = failed || chunks[c].failed;
+        }
+        if (failed) {
+            fprintf(stderr, "Out of memory\n");
+        } else if (games > UINT32_MAX) {
+            fprintf(stderr, "Too many games\n");
+        } else if (!writeDatabase(output, chunks, builder.chunkCount, games, moveBytes, entryCount)) {
+            fprintf(stderr, "Cannot write %s\n", output);
+        } else {
+            printf("%llu games (%llu skipped), %llu bytes of moves, %llu positions in %.1f s\n",
+                   (unsigned long long)games, (unsigned long long)skipped, (unsigned long long)moveBytes,
+                   (unsigned long long)entryCount, (double)(platformMilliseconds() - start) / 1000.0);
+            status = 0;
+        }
+    }
+
+    for (int c = 0; c < pathCount * threads; c++) {
+        free(chunks[c].entries);
+        free(chunks[c].moves);
+        free(chunks[c].gameBytes);
+        free(chunks[c].results);
+    }
+    for (int i = 0; i < opened; i++) pgnClose(&readers[i]);
+    free(chunks);
+    free(readers);
+    return status;
+}
+
+static const char *resultText(GameResult result) {
+    switch (result) {
+        case RESULT_WHITE_WINS: return "1-0";
+        case RESULT_BLACK_WINS: return "0-1";
+        case RESULT_DRAW: return "1/2-1/2";
+        default: return "*";
+    }
+}
+
+// Lists the games that reached the position and the move played from it
+static int query(const char *path, const char *fen, int limit) {
+    GameState position;
+    if (!gameFromFEN(fen, &position)) {
+        fprintf(stderr, "Invalid FEN\n");
+        return 1;
+    }
+    GameDb db;
+    if (!gameDbOpen(&db, path)) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return 1;
+    }
+
+    long long start = platformMilliseconds();
+    uint64_t key = zobristKey(&position);
+    uint64_t count = gameDbFind(&db, key, NULL, 0);
+    uint32_t *games = malloc((size_t)(count ? count : 1) * sizeof(uint32_t));
+    if (!games) {
+        gameDbClose(&db);
+        return 1;
+    }
+    gameDbFind(&db, key, games, count);
+
+    uint64_t wins = 0, draws = 0, losses = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        GameResult result = gameDbResult(&db, games[i]);
+        wins += result == RESULT_WHITE_WINS;
+        draws += result == RESULT_DRAW;
+        losses += result == RESULT_BLACK_WINS;
+    }
+    printf("%llu games: +%llu =%llu -%llu for white (%lld ms)\n", (unsigned long long)count,
+           (unsigned long long)wins, (unsigned long long)draws, (unsigned long long)losses,
+           platformMilliseconds() - start);
+
+    static Move moves[PGN_MAX_PLIES];
+    int status = 0;
+    for (uint64_t i = 0; i < count && i < (uint64_t)limit; i++) {
+        int plies = gameDbMoves(&db, games[i], moves, PGN_MAX_PLIES);
+        if (plies < 0) {
+            fprintf(stderr, "Game %u cannot be decoded\n", games[i]);
+            status = 1;
+            continue;
+        }
+        GameState game = initializeGame();
+        char san[PGN_MAX_SAN] = "-";
+        for (int ply = 0; ply < plies; ply++) {
+            if (zobristKey(&game) == key) {
+                moveToSan(&game, moves[ply], san);
+                break;
+            }
+            applyMove(&game, moves[ply]);
+        }
+        printf("game %u  %-7s  %4d plies  next %s\n", games[i], resultText(gameDbResult(&db, games[i])),
+               plies, san);
+    }
+
+    free(games);
+    gameDbClose(&db);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    const char *output = NULL;
+    const char *database = NULL;
+    const char *fen = FEN_START;
+    int threads = platformCpuCount();
+    int limit = 20;
+    int firstInput = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) database = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) fen = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) limit = atoi(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            firstInput = i;
+            break;
+        }
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+    if (database && !output && firstInput == argc) return query(database, fen, limit);
+    if (output && !database && firstInput < argc && threads >= 1) {
+        return build(output, argv + firstInput, argc - firstInput, threads);
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,168 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Build-time generator for the king and pawn versus king bitbase.
+// Writes a C source file with one bit per position (1 = win for the side
+// with the pawn) that is compiled into chess_core. This tool runs before
+// the core library exists, so it does not link against it.
+//
+// Positions are normalized so the pawn is white and on files a-d.
+// Squares are numbered a1 = 0 ... h8 = 63.
+
+#define KPK_POSITIONS (2 * 24 * 64 * 64)
+
+typedef enum {
+    INVALID = 0,
+    UNKNOWN = 1,
+    DRAW = 2,
+    WIN = 4
+} Result;
+
+static uint8_t results[KPK_POSITIONS];
+
+static int fileOf(int square) { return square & 7; }
+static int rankOf(int square) { return square >> 3; }
+
+static int distance(int a, int b) {
+    int files = abs(fileOf(a) - fileOf(b));
+    int ranks = abs(rankOf(a) - rankOf(b));
+    return files > ranks ? files : ranks;
+}
+
+// Same layout as the probe in bitbase.c
+static int kpkIndex(bool whiteToMove, int blackKing, int whiteKing, int pawn) {
+    return (whiteToMove ? 0 : 1) | (blackKing << 1) | (whiteKing << 7) |
+           (fileOf(pawn) << 13) | ((6 - rankOf(pawn)) << 15);
+}
+
+static bool pawnAttacks(int pawn, int square) {
+    return rankOf(square) == rankOf(pawn) + 1 && abs(fileOf(square) - fileOf(pawn)) == 1;
+}
+
+static Result classifyInitial(bool whiteToMove, int whiteKing, int blackKing, int pawn) {
+    if (distance(whiteKing, blackKing) <= 1 || whiteKing == pawn || blackKing == pawn) {
+        return INVALID;
+    }
+    // Black in check with white to move cannot happen
+    if (whiteToMove && pawnAttacks(pawn, blackKing)) {
+        return INVALID;
+    }
+
+    int queening = pawn + 8;
+    if (whiteToMove && rankOf(pawn) == 6 && whiteKing != queening && blackKing != queening &&
+        (distance(blackKing, queening) > 1 || distance(whiteKing, queening) == 1)) {
+        return WIN; // Promotes and the queen survives
+    }
+
+    if (!whiteToMove) {
+        bool canMove = false;
+        for (int to = 0; to < 64; to++) {
+            if (distance(blackKing, to) != 1) continue;
+            if (distance(whiteKing, to) <= 1 || pawnAttacks(pawn, to)) continue;
+            if (to == pawn) return DRAW; // Undefended pawn falls
+            canMove = true;
+        }
+        if (!canMove) return pawnAttacks(pawn, blackKing) ? WIN : DRAW;
+    }
+    return UNKNOWN;
+}
+
+static Result classifyFromSuccessors(bool whiteToMove, int whiteKing, int blackKing, int pawn) {
+    // Result bits of all successors; invalid ones contribute nothing
+    int seen = 0;
+
+    if (whiteToMove) {
+        for (int to = 0; to < 64; to++) {
+            if (distance(whiteKing, to) == 1) {
+                seen |= results[kpkIndex(false, blackKing, to, pawn)];
+            }
+        }
+        int push = pawn + 8;
+        if (rankOf(pawn) < 6 && push != whiteKing && push != blackKing) {
+            seen |= results[kpkIndex(false, blackKing, whiteKing, push)];
+            if (rankOf(pawn) == 1 && push + 8 != whiteKing && push + 8 != blackKing) {
+                seen |= results[kpkIndex(false, blackKing, whiteKing, push + 8)];
+            }
+        }
+        // White picks a win if there is one
+        return (seen & WIN) ? WIN : (seen & UNKNOWN) ? UNKNOWN : DRAW;
+    }
+
+    for (int to = 0; to < 64; to++) {
+        if (distance(blackKing, to) == 1 && to != pawn) {
+            seen |= results[kpkIndex(true, to, whiteKing, pawn)];
+        }
+    }
+    // Black picks a draw if there is one
+    return (seen & DRAW) ? DRAW : (seen & UNKNOWN) ? UNKNOWN : WIN;
+}
+
+static void decode(int index, bool *whiteToMove, int *whiteKing, int *blackKing, int *pawn) {
+    *whiteToMove = (index & 1) == 0;
+    *blackKing = (index >> 1) & 63;
+    *whiteKing = (index >> 7) & 63;
+    int file = (index >> 13) & 3;
+    int rank = 6 - ((index >> 15) & 7);
+    *pawn = rank * 8 + file;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: chess_kpkgen OUTPUT.c\n");
+        return 1;
+    }
+
+    for (int i = 0; i < KPK_POSITIONS; i++) {
+        bool whiteToMove;
+        int whiteKing, blackKing, pawn;
+        decode(i, &whiteToMove, &whiteKing, &blackKing, &pawn);
+        results[i] = (uint8_t)classifyInitial(whiteToMove, whiteKing, blackKing, pawn);
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < KPK_POSITIONS; i++) {
+            if (results[i] != UNKNOWN) continue;
+            bool whiteToMove;
+            int whiteKing, blackKing, pawn;
+            decode(i, &whiteToMove, &whiteKing, &blackKing, &pawn);
+            Result result = classifyFromSuccessors(whiteToMove, whiteKing, blackKing, pawn);
+            if (result != UNKNOWN) {
+                results[i] = (uint8_t)result;
+                changed = true;
+            }
+        }
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    int wins = 0;
+    fprintf(out, "// Generated by chess_kpkgen. Do not edit.\n");
+    fprintf(out, "#include <stdint.h>\n\n");
+    fprintf(out, "const uint32_t kpkBitbase[%d] = {\n", KPK_POSITIONS / 32);
+    for (int word = 0; word < KPK_POSITIONS / 32; word++) {
+        uint32_t bits = 0;
+        for (int bit = 0; bit < 32; bit++) {
+            if (results[word * 32 + bit] == WIN) {
+                bits |= 1u << bit;
+                wins++;
+            }
+        }
+        fprintf(out, "%s0x%08xu,%s", word % 8 ? " " : "    ", (unsigned)bits, word % 8 == 7 ? "\n" : "");
+    }
+    fprintf(out, "};\n");
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return 1;
+    }
+    printf("KPK bitbase: %d winning positions\n", wins);
+    return 0;
+}
@@ -0,0 +1,505 @@
+#include "fen.h"
+#include "pgn.h"
+#include "platform.h"
+#include "zobrist.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Engine-vs-engine match runner:
+//   chess_match -engine CMD [-name N] [-option NAME=VALUE]...
+//               -engine CMD [-name N] [-option NAME=VALUE]... [options]
+//
+// Engines are UCI processes, so two builds or two option sets of the same
+// build can be compared. Each worker thread owns one process per engine
+// and plays one game at a time. Every opening is played twice with colors
+// reversed. A sequential probability ratio test stops the match as soon
+// as the result is conclusive.
+
+#define MAX_OPTIONS 16
+#define MAX_OPENINGS_LINE 512
+#define MAX_LINE 8192
+
+// How long an engine may take to answer uci and isready, and how far past
+// its clock a search may run before the engine is considered hung
+#define READY_TIMEOUT_MS 10000
+#define HUNG_MARGIN_MS 1000
+
+typedef struct {
+    const char *command;
+    const char *name;
+    const char *options[MAX_OPTIONS];
+    int optionCount;
+} EngineConfig;
+
+typedef struct {
+    EngineConfig engines[2];
+    char **openings;  // FEN strings; empty means the initial position
+    int openingCount;
+    int games;
+    int concurrency;
+    int baseMs;
+    int incrementMs;
+    int maxPlies;
+    bool sprt;
+    double elo0, elo1, alpha, beta;
+} MatchConfig;
+
+typedef struct {
+    const MatchConfig *config;
+    pthread_mutex_t lock;
+    int nextGame;
+    bool finished;
+    // From the first engine's point of view
+    int wins, draws, losses;
+    int aborted;
+} Match;
+
+typedef struct {
+    ChildProcess process;
+    bool running;
+} Engine;
+
+typedef struct {
+    Match *match;
+    pthread_t thread;
+    Engine engines[2];
+} Worker;
+
+static void usage(void) {
+    printf("Usage: chess_match -engine CMD [-name N] [-option NAME=VALUE]...\n");
+    printf("                   -engine CMD [-name N] [-option NAME=VALUE]... [options]\n");
+    printf("  -openings FILE     FEN/EPD starting positions, one per line\n");
+    printf("  -games N           games to play (default 1000)\n");
+    printf("  -concurrency N     games played at once (default: all cores)\n");
+    printf("  -tc BASE+INC       clock in seconds per game plus increment (default 10+0.1)\n");
+    printf("  -maxplies N        adjudicate a draw after N plies (default 400)\n");
+    printf("  -sprt ELO0 ELO1    stop once H0 (elo0) or H1 (elo1) is accepted\n");
+    printf("  -alpha A -beta B   SPRT error rates (default 0.05)\n");
+}
+
+// SPRT on the logistic Elo scale using the normal approximation to the
+// log-likelihood ratio of the two hypotheses
+static double eloToScore(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+static double sprtLLR(int wins, int draws, int losses, double elo0, double elo1) {
+    double games = wins + draws + losses;
+    if (games == 0) return 0.0;
+    double mean = (wins + draws * 0.5) / games;
+    double variance = (wins + draws * 0.25) / games - mean * mean;
+    if (variance <= 0.0) return 0.0;
+    double s0 = eloToScore(elo0), s1 = eloToScore(elo1);
+    return 0.5 * games * (s1 - s0) * (2.0 * mean - s0 - s1) / variance;
+}
+
+static double scoreToElo(double score) {
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+// Elo difference with a 95% confidence margin
+static void eloEstimate(int wins, int draws, int losses, double *elo, double *margin) {
+    double games = wins + draws + losses;
+    double mean = (wins + draws * 0.5) / games;
+    double variance = (wins + draws * 0.25) / games - mean * mean;
+    double spread = 1.96 * sqrt(variance / games);
+    double low = mean - spread, high = mean + spread;
+    if (mean <= 0.0 || mean >= 1.0 || low <= 0.0 || high >= 1.0) {
+        *elo = mean >= 1.0 ? INFINITY : mean <= 0.0 ? -INFINITY : scoreToElo(mean);
+        *margin = INFINITY;
+        return;
+    }
+    *elo = scoreToElo(mean);
+    *margin = (scoreToElo(high) - scoreToElo(low)) / 2.0;
+}
+
+// Reads one line, giving up once platformMilliseconds() reaches deadline
+static PlatformReadResult readLine(Engine *engine, char *line, size_t size, long long deadline) {
+    long long remaining = deadline - platformMilliseconds();
+    if (remaining <= 0) return PLATFORM_READ_TIMEOUT;
+    return platformReadLine(&engine->process, line, size, (int)remaining);
+}
+
+static bool sendCommand(Engine *engine, const char *command) {
+    return fprintf(engine->process.input, "%s\n", command) >= 0 && fflush(engine->process.input) == 0;
+}
+
+static bool waitFor(Engine *engine, const char *reply) {
+    char line[MAX_LINE];
+    long long deadline = platformMilliseconds() + READY_TIMEOUT_MS;
+    while (readLine(engine, line, sizeof(line), deadline) == PLATFORM_READ_LINE) {
+        if (strcmp(line, reply) == 0) return true;
+    }
+    return false;
+}
+
+static void engineStop(Engine *engine) {
+    if (!engine->running) return;
+    sendCommand(engine, "quit");
+    platformCloseProcess(&engine->process);
+    engine->running = false;
+}
+
+// For an engine that stopped answering and may never read "quit"
+static void engineKill(Engine *engine) {
+    if (!engine->running) return;
+    platformKillProcess(&engine->process);
+    engine->running = false;
+}
+
+static bool engineStart(Engine *engine, const EngineConfig *config) {
+    if (!platformSpawn(config->command, &engine->process)) return false;
+    engine->running = true;
+
+    bool ok = sendCommand(engine, "uci") && waitFor(engine, "uciok");
+    for (int i = 0; ok && i < config->optionCount; i++) {
+        char command[MAX_LINE];
+        const char *equals = strchr(config->options[i], '=');
+        int nameLength = (int)(equals - config->options[i]);
+        snprintf(command, sizeof(command), "setoption name %.*s value %s",
+                 nameLength, config->options[i], equals + 1);
+        ok = sendCommand(engine, command);
+    }
+    ok = ok && sendCommand(engine, "isready") && waitFor(engine, "readyok");
+    if (!ok) engineKill(engine);
+    return ok;
+}
+
+// Bare kings, or a single minor piece against a bare king
+static bool insufficientMaterial(const GameState *game) {
+    int minors = 0;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            PieceType type = PIECE_TYPE(game->board[SQUARE(x, y)]);
+            if (type == KNIGHT || type == BISHOP) minors++;
+            else if (type != EMPTY && type != KING) return false;
+        }
+    }
+    return minors <= 1;
+}
+
+static GameResult winFor(ColorPieces color) {
+    return color == COLOR_WHITE ? RESULT_WHITE_WINS : RESULT_BLACK_WINS;
+}
+
+static void moveToUci(Move move, char text[6]) {
+    int length = 0;
+    text[length++] = (char)('a' + MOVE_FROM_X(move));
+    text[length++] = (char)('8' - MOVE_FROM_Y(move));
+    text[length++] = (char)('a' + MOVE_TO_X(move));
+    text[length++] = (char)('8' - MOVE_TO_Y(move));
+    if (MOVE_KIND(move) == MOVE_PROMOTION) text[length++] = "  nbrq"[MOVE_PROMOTION_PIECE(move)];
+    text[length] = '\0';
+}
+
+// Plays one game. white is the index of the engine with the white
+// pieces. Returns RESULT_NONE if the game could not be finished; *failed
+// is set to the index of an engine that crashed, or -1.
+static GameResult playGame(Worker *worker, const char *opening, int white, int *failed) {
+    const MatchConfig *config = worker->match->config;
+    *failed = -1;
+
+    GameState game = initializeGame();
+    if (opening && !gameFromFEN(opening, &game)) return RESULT_NONE;
+
+    for (int i = 0; i < 2; i++) {
+        Engine *engine = &worker->engines[i];
+        if (!sendCommand(engine, "ucinewgame") || !sendCommand(engine, "isready") ||
+            !waitFor(engine, "readyok")) {
+            *failed = i;
+            return RESULT_NONE;
+        }
+    }
+
+    // "position ..." prefix followed by every move played so far
+    char position[MAX_LINE * 2];
+    int length = opening ? snprintf(position, sizeof(position), "position fen %s moves", opening)
+                         : snprintf(position, sizeof(position), "position startpos moves");
+    uint64_t keys[1024];
+    int keyCount = 0;
+    int quietPlies = 0;  // Since the last capture or pawn move
+    int clocks[2] = { config->baseMs, config->baseMs };
+
+    for (int ply = 0; ply < config->maxPlies && ply < 1024; ply++) {
+        Move moves[MAX_MOVES];
+        int count = generateLegalMoves(&game, moves);
+        ColorPieces opponent = game.currentTurn == COLOR_WHITE ? COLOR_BLACK : COLOR_WHITE;
+        if (count == 0) return game.isCheck ? winFor(opponent) : RESULT_DRAW;
+
+        uint64_t key = zobristKey(&game);
+        int repeats = 0;
+        for (int i = 0; i < keyCount; i++) repeats += keys[i] == key;
+        if (repeats >= 2 || quietPlies >= 100 || insufficientMaterial(&game)) return RESULT_DRAW;
+        keys[keyCount++] = key;
+
+        int side = game.currentTurn == COLOR_WHITE ? 0 : 1;
+        int index = side == 0 ? white : 1 - white;
+        Engine *engine = &worker->engines[index];
+
+        char go[128];
+        snprintf(go, sizeof(go), "go wtime %d btime %d winc %d binc %d",
+                 clocks[0], clocks[1], config->incrementMs, config->incrementMs);
+        long long started = platformMilliseconds();
+        if (!sendCommand(engine, position) || !sendCommand(engine, go)) {
+            *failed = index;
+            return RESULT_NONE;
+        }
+
+        // An engine with no bestmove well past its clock has hung: it forfeits
+        // on time and is restarted for the next game
+        char line[MAX_LINE];
+        long long deadline = started + clocks[side] + HUNG_MARGIN_MS;
+        PlatformReadResult status = PLATFORM_READ_LINE;
+        bool replied = false;
+        while (!replied && status == PLATFORM_READ_LINE) {
+            status = readLine(engine, line, sizeof(line), deadline);
+            replied = status == PLATFORM_READ_LINE && strncmp(line, "bestmove ", 9) == 0;
+        }
+        if (status == PLATFORM_READ_TIMEOUT) {
+            engineKill(engine);
+            return winFor(opponent);
+        }
+        if (!replied) {
+            *failed = index;
+            return RESULT_NONE;
+        }
+        clocks[side] -= (int)(platformMilliseconds() - started);
+        if (clocks[side] < 0) return winFor(opponent);
+        clocks[side] += config->incrementMs;
+
+        char *text = line + 9;
+        text[strcspn(text, " ")] = '\0';
+
+        Move move = MOVE_NONE;
+        for (int i = 0; i < count && move == MOVE_NONE; i++) {
+            char legal[6];
+            moveToUci(moves[i], legal);
+            if (strcmp(legal, text) == 0) move = moves[i];
+        }
+        if (move == MOVE_NONE) return winFor(opponent);
+
+        Piece piece = game.board[MOVE_FROM_SQUARE(move)];
+        bool capture = game.board[MOVE_TO_SQUARE(move)] != EMPTY ||
+                       MOVE_KIND(move) == MOVE_EN_PASSANT;
+        quietPlies = (capture || PIECE_TYPE(piece) == PAWN) ? 0 : quietPlies + 1;
+        applyMove(&game, move);
+        length += snprintf(position + length, sizeof(position) - (size_t)length, " %s", text);
+    }
+    return RESULT_DRAW;
+}
+
+static void report(Match *match) {
+    const MatchConfig *config = match->config;
+    int games = match->wins + match->draws + match->losses;
+    double elo, margin;
+    eloEstimate(match->wins, match->draws, match->losses, &elo, &margin);
+    printf("Games %d: +%d =%d -%d  Elo %.1f +/- %.1f", games, match->wins, match->draws,
+           match->losses, elo, margin);
+    if (config->sprt) {
+        double llr = sprtLLR(match->wins, match->draws, match->losses, config->elo0, config->elo1);
+        printf("  LLR %.2f [%.2f, %.2f]", llr, log(config->beta / (1.0 - config->alpha)),
+               log((1.0 - config->beta) / config->alpha));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void recordResult(Match *match, GameResult result, int white) {
+    pthread_mutex_lock(&match->lock);
+    if (result == RESULT_NONE) {
+        match->aborted++;
+    } else if (result == RESULT_DRAW) {
+        match->draws++;
+    } else if ((result == RESULT_WHITE_WINS) == (white == 0)) {
+        match->wins++;
+    } else {
+        match->losses++;
+    }
+
+    if (result != RESULT_NONE) {
+        report(match);
+        const MatchConfig *config = match->config;
+        if (config->sprt) {
+            double llr = sprtLLR(match->wins, match->draws, match->losses, config->elo0, config->elo1);
+            if (llr >= log((1.0 - config->beta) / config->alpha)) {
+                printf("SPRT: H1 accepted (elo >= %.1f)\n", config->elo1);
+                match->finished = true;
+            } else if (llr <= log(config->beta / (1.0 - config->alpha))) {
+                printf("SPRT: H0 accepted (elo <= %.1f)\n", config->elo0);
+                match->finished = true;
+            }
+        }
+    }
+    pthread_mutex_unlock(&match->lock);
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    Match *match = worker->match;
+    const MatchConfig *config = match->config;
+
+    for (;;) {
+        pthread_mutex_lock(&match->lock);
+        int index = match->finished || match->nextGame >= config->games ? -1 : match->nextGame++;
+        pthread_mutex_unlock(&match->lock);
+        if (index < 0) break;
+
+        // (Re)start engines that are not running, e.g. after a crash
+        bool ready = true;
+        for (int i = 0; i < 2 && ready; i++) {
+            if (!worker->engines[i].running) ready = engineStart(&worker->engines[i], &config->engines[i]);
+            if (!ready) fprintf(stderr, "Cannot start %s\n", config->engines[i].command);
+        }
+        if (!ready) {
+            pthread_mutex_lock(&match->lock);
+            match->finished = true;
+            pthread_mutex_unlock(&match->lock);
+            break;
+        }
+
+        // Each opening is played twice with colors reversed
+        const char *opening = config->openingCount ? config->openings[(index / 2) % config->openingCount] : NULL;
+        int white = index & 1;
+        int failed;
+        GameResult result = playGame(worker, opening, white, &failed);
+        if (failed >= 0) {
+            // A crash or a broken pipe loses the game
+            result = winFor((failed == white) ? COLOR_BLACK : COLOR_WHITE);
+            engineKill(&worker->engines[failed]);
+        }
+        recordResult(match, result, white);
+    }
+
+    engineStop(&worker->engines[0]);
+    engineStop(&worker->engines[1]);
+    return NULL;
+}
+
+static bool loadOpenings(const char *path, MatchConfig *config) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    int capacity = 0;
+    char line[MAX_OPENINGS_LINE];
+    GameState scratch;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!gameFromFEN(line, &scratch)) continue;
+
+        // Keep the four position fields; EPD operations are dropped
+        char *field = line;
+        for (int spaces = 0; *field; field++) {
+            if (*field == ' ' && ++spaces == 4) break;
+        }
+        *field = '\0';
+
+        if (config->openingCount == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            char **grown = realloc(config->openings, (size_t)capacity * sizeof(char *));
+            if (!grown) break;
+            config->openings = grown;
+        }
+        config->openings[config->openingCount] = malloc(strlen(line) + 1);
+        if (!config->openings[config->openingCount]) break;
+        strcpy(config->openings[config->openingCount++], line);
+    }
+    fclose(file);
+    return config->openingCount > 0;
+}
+
+int main(int argc, char **argv) {
+    MatchConfig config;
+    memset(&config, 0, sizeof(config));
+    config.games = 1000;
+    config.concurrency = platformCpuCount();
+    config.baseMs = 10000;
+    config.incrementMs = 100;
+    config.maxPlies = 400;
+    config.alpha = config.beta = 0.05;
+
+    int engineCount = 0;
+    const char *openings = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        EngineConfig *engine = engineCount ? &config.engines[engineCount - 1] : NULL;
+        if (strcmp(arg, "-engine") == 0 && hasValue && engineCount < 2) {
+            config.engines[engineCount].command = argv[++i];
+            config.engines[engineCount].name = argv[i];
+            engineCount++;
+        } else if (strcmp(arg, "-name") == 0 && hasValue && engine) {
+            engine->name = argv[++i];
+        } else if (strcmp(arg, "-option") == 0 && hasValue && engine &&
+                   engine->optionCount < MAX_OPTIONS && strchr(argv[i + 1], '=')) {
+            engine->options[engine->optionCount++] = argv[++i];
+        } else if (strcmp(arg, "-openings") == 0 && hasValue) {
+            openings = argv[++i];
+        } else if (strcmp(arg, "-games") == 0 && hasValue) {
+            config.games = atoi(argv[++i]);
+        } else if (strcmp(arg, "-concurrency") == 0 && hasValue) {
+            config.concurrency = atoi(argv[++i]);
+        } else if (strcmp(arg, "-maxplies") == 0 && hasValue) {
+            config.maxPlies = atoi(argv[++i]);
+        } else if (strcmp(arg, "-tc") == 0 && hasValue) {
+            double base = atof(argv[++i]);
+            const char *plus = strchr(argv[i], '+');
+            config.baseMs = (int)(base * 1000);
+            config.incrementMs = plus ? (int)(atof(plus + 1) * 1000) : 0;
+        } else if (strcmp(arg, "-sprt") == 0 && i + 2 < argc) {
+            config.sprt = true;
+            config.elo0 = atof(argv[++i]);
+            config.elo1 = atof(argv[++i]);
+        } else if (strcmp(arg, "-alpha") == 0 && hasValue) {
+            config.alpha = atof(argv[++i]);
+        } else if (strcmp(arg, "-beta") == 0 && hasValue) {
+            config.beta = atof(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (engineCount != 2 || config.games < 1 || config.concurrency < 1 || config.baseMs <= 0 ||
+        config.maxPlies < 1 || (config.sprt && (config.elo1 <= config.elo0 || config.alpha <= 0 ||
+        config.beta <= 0 || config.alpha + config.beta >= 1))) {
+        usage();
+        return 1;
+    }
+    if (openings && !loadOpenings(openings, &config)) {
+        fprintf(stderr, "No usable positions in %s\n", openings);
+        return 1;
+    }
+    if (config.concurrency > config.games) config.concurrency = config.games;
+
+    printf("%s vs %s, %d games, %d at a time\n", config.engines[0].name, config.engines[1].name,
+           config.games, config.concurrency);
+
+    Match match;
+    memset(&match, 0, sizeof(match));
+    match.config = &config;
+    pthread_mutex_init(&match.lock, NULL);
+
+    Worker *workers = calloc((size_t)config.concurrency, sizeof(Worker));
+    int started = 0;
+    for (int i = 0; workers && i < config.concurrency; i++) {
+        workers[i].match = &match;
+        if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0) break;
+        started++;
+    }
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+    if (match.aborted) printf("%d games could not be finished\n", match.aborted);
+    int games = match.wins + match.draws + match.losses;
+    if (games > 0) {
+        printf("Final: ");
+        report(&match);
+    }
+
+    pthread_mutex_destroy(&match.lock);
+    for (int i = 0; i < config.openingCount; i++) free(config.openings[i]);
+    free(config.openings);
+    free(workers);
+    return games > 0 ? 0 : 1;
+}
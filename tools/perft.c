@@ -0,0 +1,167 @@
+#include "fen.h"
+#include "perft.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headless move generator test:
+//   chess_perft [-t threads] [-s split] [-H MB] [-f fen] DEPTH
+//   chess_perft [-t threads] [-s split] [-H MB] -e SUITE.epd [DEPTH]
+//
+// The first form prints the leaf count and a per-thread breakdown, so
+// scaling can be read straight off the nodes per second column. The
+// second checks every ";D<depth> <nodes>" entry of a perft suite, up to
+// DEPTH if one is given, and that the mate and stalemate tests agree with
+// the move generator on every suite position.
+
+typedef struct {
+    int threads;
+    int splitDepth;
+} PerftOptions;
+
+static void usage(void) {
+    printf("Usage: chess_perft [options] DEPTH\n");
+    printf("       chess_perft [options] -e SUITE.epd [DEPTH]\n");
+    printf("  -f FEN     position to count from (default: start position)\n");
+    printf("  -e FILE    check the expected counts and mate/stalemate tests of a perft suite\n");
+    printf("  -t N       worker threads (default: all cores)\n");
+    printf("  -s N       split the tree into tasks N plies below the root (default %d, max %d)\n",
+           PERFT_DEFAULT_SPLIT, PERFT_MAX_SPLIT);
+    printf("  -H MB      subtree count table, 0 to disable (default %d)\n", PERFT_DEFAULT_HASH_MB);
+}
+
+static double megaNodesPerSecond(unsigned long long nodes, long long timeMs) {
+    return timeMs > 0 ? (double)nodes / (double)timeMs / 1000.0 : 0.0;
+}
+
+static void runPosition(const GameState *game, int depth, const PerftOptions *options) {
+    static PerftThreadStats stats[PERFT_MAX_THREADS];
+    long long start = platformMilliseconds();
+    unsigned long long nodes = perftParallel(game, depth, options->splitDepth, options->threads, stats);
+    long long elapsed = platformMilliseconds() - start;
+
+    printf("Thread        Nodes   Tasks  Steals   Time ms     Mnps\n");
+    for (int i = 0; i < options->threads; i++) {
+        printf("%6d %12llu %7d %7d %9lld %8.2f\n", i, stats[i].nodes, stats[i].tasks,
+               stats[i].steals, stats[i].timeMs, megaNodesPerSecond(stats[i].nodes, stats[i].timeMs));
+    }
+    printf("Depth %d: %llu nodes in %.3f s (%.2f Mnps)\n", depth, nodes, (double)elapsed / 1000.0,
+           megaNodesPerSecond(nodes, elapsed));
+}
+
+// hasAnyLegalMove must find a move exactly when generateLegalMoves does,
+// and isCheckmate and isStalemate must return and store the answers the
+// generated moves imply
+static bool endStatesAgree(GameState game) {
+    Move moves[MAX_MOVES];
+    bool anyMove = generateLegalMoves(&game, moves) > 0;
+    bool inCheck = isInCheck(&game, game.currentTurn);
+    bool checkmate = isCheckmate(&game);
+    bool stalemate = isStalemate(&game);
+    return hasAnyLegalMove(&game) == anyMove &&
+           checkmate == (inCheck && !anyMove) && game.isCheckmate == checkmate &&
+           stalemate == (!inCheck && !anyMove) && game.isStalemate == stalemate;
+}
+
+// Returns the number of failed checks, or -1 if the file cannot be read
+static int runSuite(const char *path, int maxDepth, const PerftOptions *options) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    int checks = 0, failures = 0, lineNumber = 0;
+    long long start = platformMilliseconds();
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *fields = strchr(line, ';');
+        if (!fields) continue;
+        *fields++ = '\0';
+
+        GameState game;
+        if (!gameFromFEN(line, &game)) {
+            printf("line %d: invalid FEN\n", lineNumber);
+            failures++;
+            continue;
+        }
+
+        checks++;
+        if (!endStatesAgree(game)) {
+            printf("line %d: mate and stalemate tests disagree with the move list  %s\n",
+                   lineNumber, line);
+            failures++;
+        }
+
+        for (char *field = strtok(fields, ";"); field; field = strtok(NULL, ";")) {
+            int depth;
+            unsigned long long expected;
+            if (sscanf(field, " D%d %llu", &depth, &expected) != 2) continue;
+            if (maxDepth >= 0 && depth > maxDepth) continue;
+
+            unsigned long long nodes = perftParallel(&game, depth, options->splitDepth,
+                                                     options->threads, NULL);
+            checks++;
+            if (nodes != expected) {
+                printf("line %d: depth %d gave %llu, expected %llu  %s\n",
+                       lineNumber, depth, nodes, expected, line);
+                failures++;
+            }
+        }
+    }
+    fclose(file);
+
+    printf("%d checks, %d failed in %.3f s\n", checks, failures,
+           (double)(platformMilliseconds() - start) / 1000.0);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    PerftOptions options = { platformCpuCount(), PERFT_DEFAULT_SPLIT };
+    const char *fen = FEN_START;
+    const char *suite = NULL;
+    int hashMegabytes = PERFT_DEFAULT_HASH_MB;
+    int depth = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            suite = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            options.splitDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            hashMegabytes = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' || depth >= 0) {
+            usage();
+            return 1;
+        } else {
+            depth = atoi(argv[i]);
+        }
+    }
+    if ((depth < 0 && !suite) || options.threads < 1 || options.threads > PERFT_MAX_THREADS ||
+        options.splitDepth < 1 || options.splitDepth > PERFT_MAX_SPLIT || hashMegabytes < 0) {
+        usage();
+        return 1;
+    }
+    if (!perftSetHash((size_t)hashMegabytes)) {
+        fprintf(stderr, "Cannot allocate %d MB\n", hashMegabytes);
+        return 1;
+    }
+
+    if (suite) {
+        int failures = runSuite(suite, depth, &options);
+        if (failures < 0) fprintf(stderr, "Cannot read %s\n", suite);
+        return failures == 0 ? 0 : 1;
+    }
+
+    GameState game;
+    if (!gameFromFEN(fen, &game)) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        return 1;
+    }
+    runPosition(&game, depth, &options);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "platform.h"
+#include "tablebase.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headless tablebase generator:
+//   chess_tbgen [-t threads] [-d directory] SIGNATURE...
+//   chess_tbgen [-t threads] [-d directory] -a PIECES
+
+static void usage(void) {
+    printf("Usage: chess_tbgen [-t threads] [-d directory] [-a pieces] [SIGNATURE...]\n");
+    printf("  SIGNATURE  pawnless material such as KQvK or KRBvKR\n");
+    printf("  -a N       generate every pawnless signature with up to N pieces (max %d)\n",
+           TB_MAX_PIECES);
+    printf("  -t N       worker threads (default: all cores)\n");
+    printf("  -d DIR     output directory (default: current directory)\n");
+}
+
+static bool generateAll(int maxPieces, const char *directory, int threads) {
+    char names[TB_MAX_SIGNATURES][16];
+    int count = tbListSignatures(maxPieces, names, TB_MAX_SIGNATURES);
+    for (int i = 0; i < count; i++) {
+        if (!tbGenerate(names[i], directory, threads)) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int threads = platformCpuCount();
+    const char *directory = ".";
+    int allPieces = 0;
+    int signatures = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            allPieces = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            signatures++;
+        }
+    }
+
+    if ((signatures == 0 && allPieces == 0) || threads < 1 ||
+        allPieces < 0 || allPieces > TB_MAX_PIECES) {
+        usage();
+        return 1;
+    }
+
+    if (allPieces >= 3 && !generateAll(allPieces, directory, threads)) {
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            i++;
+            continue;
+        }
+        if (!tbGenerate(argv[i], directory, threads)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include "eval_weights.h"
+#include "evaluate.h"
+#include "fen.h"
+#include "packed.h"
+#include "platform.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Texel-style tuner for the evaluation weights:
+//   chess_tune [options] POSITIONS.epd...
+//
+// Each input line is a FEN or EPD position followed by the game result
+// ("1-0", "0-1", "1/2-1/2", or [1.0] / [0.5] / [0.0]). Files ending in
+// .pos are packed positions, labeled by their result field; -p saves the
+// text positions in that form so later runs load them much faster. The
+// evaluation is
+// linear in the weights, so a position is stored as just its pieces and
+// evaluated as a sum of weights. The logistic loss and its gradient are
+// computed over all positions in parallel, and Adam updates the weights
+// once per epoch. The result is written as a new eval_weights.h.
+
+#define MAX_PIECES 32
+#define K_SEARCH_STEPS 40
+
+// Positions packed back to back: the pieces of position i are
+// pieces[offsets[i]] up to pieces[offsets[i + 1]]. A piece is
+// type - 1 | color << 3 | square << 4, with color 0 for white.
+typedef struct {
+    uint16_t *pieces;
+    uint32_t *offsets;
+    uint8_t *results;  // 0 = black won, 1 = draw, 2 = white won
+    size_t count;
+    size_t pieceCount;
+    size_t capacity;
+    size_t pieceCapacity;
+} Dataset;
+
+typedef struct {
+    const Dataset *data;
+    const double *weights;
+    double k;
+    size_t begin, end;
+    bool wantGradient;
+    bool threaded;
+    pthread_t thread;
+    double loss;
+    double gradient[EVAL_WEIGHT_COUNT];
+} Slice;
+
+static void usage(void) {
+    printf("Usage: chess_tune [options] POSITIONS.epd...\n");
+    printf("  -o FILE    output header (default eval_weights.h)\n");
+    printf("  -e N       epochs (default 500)\n");
+    printf("  -r RATE    Adam learning rate in centipawns (default 1.0)\n");
+    printf("  -k K       sigmoid scale; fitted to the data when omitted\n");
+    printf("  -t N       threads (default: all cores)\n");
+    printf("  -p FILE    also save the text positions as packed positions\n");
+}
+
+static bool parseResult(const char *line, uint8_t *result) {
+    if (strstr(line, "1/2-1/2") || strstr(line, "[0.5]")) *result = 1;
+    else if (strstr(line, "1-0") || strstr(line, "[1.0]")) *result = 2;
+    else if (strstr(line, "0-1") || strstr(line, "[0.0]")) *result = 0;
+    else return false;
+    return true;
+}
+
+static bool grow(Dataset *data) {
+    if (data->count + 1 >= data->capacity) {
+        size_t capacity = data->capacity ? data->capacity * 2 : 1 << 16;
+        uint32_t *offsets = realloc(data->offsets, capacity * sizeof(uint32_t));
+        if (!offsets) return false;
+        data->offsets = offsets;
+        uint8_t *results = realloc(data->results, capacity);
+        if (!results) return false;
+        data->results = results;
+        data->capacity = capacity;
+    }
+    if (data->pieceCount + MAX_PIECES > data->pieceCapacity) {
+        size_t capacity = data->pieceCapacity ? data->pieceCapacity * 2 : 1 << 20;
+        uint16_t *pieces = realloc(data->pieces, capacity * sizeof(uint16_t));
+        if (!pieces) return false;
+        data->pieces = pieces;
+        data->pieceCapacity = capacity;
+    }
+    return true;
+}
+
+static bool addPosition(Dataset *data, const GameState *game, uint8_t result) {
+    if (!grow(data)) return false;
+    data->offsets[data->count] = (uint32_t)data->pieceCount;
+    data->results[data->count] = result;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            Piece piece = game->board[SQUARE(x, y)];
+            if (piece == EMPTY) continue;
+            int color = PIECE_COLOR(piece) == COLOR_WHITE ? 0 : 1;
+            data->pieces[data->pieceCount++] = (uint16_t)((PIECE_TYPE(piece) - 1) | color << 3 | (y * 8 + x) << 4);
+        }
+    }
+    data->count++;
+    data->offsets[data->count] = (uint32_t)data->pieceCount;
+    return true;
+}
+
+static bool loadPackedFile(const char *path, Dataset *data) {
+    PackedFile file;
+    if (!packedOpen(&file, path)) return false;
+
+    static const uint8_t labels[] = { [RESULT_WHITE_WINS] = 2, [RESULT_BLACK_WINS] = 0, [RESULT_DRAW] = 1 };
+    GameState game;
+    PackedInfo info;
+    for (size_t i = 0; i < file.count; i++) {
+        if (!unpackPosition(&file.positions[i], &game, &info) || info.result == RESULT_NONE) continue;
+        if (!addPosition(data, &game, labels[info.result])) break;
+    }
+    packedClose(&file);
+    return true;
+}
+
+// packedOut, when set, receives every labeled position that was loaded
+static bool loadFile(const char *path, Dataset *data, FILE *packedOut) {
+    size_t length = strlen(path);
+    if (length > 4 && strcmp(path + length - 4, ".pos") == 0) return loadPackedFile(path, data);
+
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    static const GameResult results[] = { RESULT_BLACK_WINS, RESULT_DRAW, RESULT_WHITE_WINS };
+    char line[512];
+    GameState game;
+    while (fgets(line, sizeof(line), file)) {
+        uint8_t result;
+        if (!parseResult(line, &result) || !gameFromFEN(line, &game)) continue;
+        if (!addPosition(data, &game, result)) break;
+        if (packedOut) {
+            PackedInfo info = { 0, 1, 0, results[result] };
+            PackedPosition packed;
+            packPosition(&game, &info, &packed);
+            fwrite(&packed, sizeof(packed), 1, packedOut);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Weight indices of a packed piece: its value and its square term
+static void featuresOf(uint16_t piece, int *value, int *square, int *sign) {
+    int type = (piece & 7) + 1;
+    ColorPieces color = (piece & 8) ? COLOR_BLACK : COLOR_WHITE;
+    int boardSquare = piece >> 4;
+    *value = EVAL_VALUE_INDEX(type);
+    *square = EVAL_SQUARE_INDEX(type, color, boardSquare & 7, boardSquare >> 3);
+    *sign = color == COLOR_WHITE ? 1 : -1;
+}
+
+// Static evaluation from white's point of view, matching evaluate()
+static double linearEval(const Dataset *data, size_t index, const double *weights) {
+    double score = 0.0;
+    for (uint32_t i = data->offsets[index]; i < data->offsets[index + 1]; i++) {
+        int value, square, sign;
+        featuresOf(data->pieces[i], &value, &square, &sign);
+        score += sign * (weights[value] + weights[square]);
+    }
+    return score;
+}
+
+// Expected score for white, with scale = k * ln(10) / 400
+static double sigmoid(double scale, double score) {
+    return 1.0 / (1.0 + exp(-scale * score));
+}
+
+static void *sliceMain(void *arg) {
+    Slice *slice = arg;
+    const Dataset *data = slice->data;
+    const double scale = slice->k * log(10.0) / 400.0;
+    slice->loss = 0.0;
+    memset(slice->gradient, 0, sizeof(slice->gradient));
+
+    for (size_t i = slice->begin; i < slice->end; i++) {
+        double predicted = sigmoid(scale, linearEval(data, i, slice->weights));
+        double error = data->results[i] * 0.5 - predicted;
+        slice->loss += error * error;
+        if (!slice->wantGradient) continue;
+
+        // d(error^2)/d(score), the same for every weight the position uses
+        double slope = -2.0 * error * predicted * (1.0 - predicted) * scale;
+        for (uint32_t p = data->offsets[i]; p < data->offsets[i + 1]; p++) {
+            int value, square, sign;
+            featuresOf(data->pieces[p], &value, &square, &sign);
+            slice->gradient[value] += sign * slope;
+            slice->gradient[square] += sign * slope;
+        }
+    }
+    return NULL;
+}
+
+// Mean loss over the dataset; also the mean gradient when gradient is set
+static double evaluateLoss(const Dataset *data, const double *weights, double k,
+                           Slice *slices, int threads, double *gradient) {
+    size_t share = (data->count + (size_t)threads - 1) / (size_t)threads;
+    for (int t = 0; t < threads; t++) {
+        Slice *slice = &slices[t];
+        slice->data = data;
+        slice->weights = weights;
+        slice->k = k;
+        slice->wantGradient = gradient != NULL;
+        slice->begin = share * (size_t)t < data->count ? share * (size_t)t : data->count;
+        slice->end = slice->begin + share < data->count ? slice->begin + share : data->count;
+        // The calling thread takes the last slice itself
+        slice->threaded = t < threads - 1 && pthread_create(&slice->thread, NULL, sliceMain, slice) == 0;
+        if (!slice->threaded) sliceMain(slice);
+    }
+
+    double loss = 0.0;
+    if (gradient) memset(gradient, 0, EVAL_WEIGHT_COUNT * sizeof(double));
+    for (int t = 0; t < threads; t++) {
+        Slice *slice = &slices[t];
+        if (slice->threaded) pthread_join(slice->thread, NULL);
+        loss += slice->loss;
+        for (int w = 0; gradient && w < EVAL_WEIGHT_COUNT; w++) gradient[w] += slice->gradient[w];
+    }
+    for (int w = 0; gradient && w < EVAL_WEIGHT_COUNT; w++) gradient[w] /= (double)data->count;
+    return loss / (double)data->count;
+}
+
+// Golden section search for the scale that best fits the start weights
+static double fitK(const Dataset *data, const double *weights, Slice *slices, int threads) {
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double low = 0.1, high = 4.0;
+    for (int i = 0; i < K_SEARCH_STEPS; i++) {
+        double a = high - ratio * (high - low);
+        double b = low + ratio * (high - low);
+        if (evaluateLoss(data, weights, a, slices, threads, NULL) <
+            evaluateLoss(data, weights, b, slices, threads, NULL)) {
+            high = b;
+        } else {
+            low = a;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+static bool writeHeader(const char *path, const double *weights) {
+    static const char *names[] = { "Pawn", "Knight", "Bishop", "Rook", "Queen", "King" };
+    FILE *file = fopen(path, "w");
+    if (!file) return false;
+
+    fprintf(file, "// Generated by chess_tune. Do not edit by hand; rerun the tuner instead.\n");
+    fprintf(file, "#ifndef EVAL_WEIGHTS_H\n#define EVAL_WEIGHTS_H\n\n#include \"evaluate.h\"\n\n");
+    fprintf(file, "static const int evalWeights[EVAL_WEIGHT_COUNT] = {\n");
+    fprintf(file, "    // Piece values\n   ");
+    for (int i = 0; i < 6; i++) fprintf(file, " %d,", (int)lround(weights[EVAL_PIECE_VALUES + i]));
+    fprintf(file, "\n");
+    for (int type = 0; type < 6; type++) {
+        fprintf(file, "    // %s squares\n", names[type]);
+        for (int row = 0; row < 8; row++) {
+            fprintf(file, "   ");
+            for (int x = 0; x < 8; x++) {
+                fprintf(file, " %d,", (int)lround(weights[EVAL_PIECE_SQUARES + type * 64 + row * 8 + x]));
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fprintf(file, "};\n\n#endif // EVAL_WEIGHTS_H\n");
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *output = "eval_weights.h";
+    int epochs = 500;
+    double rate = 1.0;
+    double k = 0.0;
+    int threads = platformCpuCount();
+    const char *packedPath = NULL;
+    Dataset data;
+    memset(&data, 0, sizeof(data));
+
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) epochs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) k = atof(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) packedPath = argv[++i];
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            argv[files++] = argv[i];
+        }
+    }
+    if (files == 0 || epochs < 0 || rate <= 0.0 || threads < 1) {
+        usage();
+        return 1;
+    }
+
+    FILE *packedOut = NULL;
+    if (packedPath && !(packedOut = fopen(packedPath, "wb"))) {
+        fprintf(stderr, "Cannot write %s\n", packedPath);
+        return 1;
+    }
+    for (int i = 0; i < files; i++) {
+        if (!loadFile(argv[i], &data, packedOut)) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (packedOut && (ferror(packedOut) || fclose(packedOut) != 0)) {
+        fprintf(stderr, "Cannot write %s\n", packedPath);
+        return 1;
+    }
+    if (data.count == 0) {
+        fprintf(stderr, "No labeled positions found\n");
+        return 1;
+    }
+    printf("%zu positions, %.1f MB\n", data.count,
+           (data.pieceCount * sizeof(uint16_t) + data.count * (sizeof(uint32_t) + 1)) / 1048576.0);
+
+    double weights[EVAL_WEIGHT_COUNT];
+    for (int i = 0; i < EVAL_WEIGHT_COUNT; i++) weights[i] = evalWeights[i];
+
+    Slice *slices = calloc((size_t)threads, sizeof(Slice));
+    if (!slices) return 1;
+    if (k <= 0.0) {
+        k = fitK(&data, weights, slices, threads);
+        printf("Fitted K = %.4f\n", k);
+    }
+
+    // Adam; the king value is fixed, it cancels out anyway
+    double gradient[EVAL_WEIGHT_COUNT];
+    double moment[EVAL_WEIGHT_COUNT] = { 0 };
+    double velocity[EVAL_WEIGHT_COUNT] = { 0 };
+    const double beta1 = 0.9, beta2 = 0.999;
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        long long started = platformMilliseconds();
+        double loss = evaluateLoss(&data, weights, k, slices, threads, gradient);
+        for (int w = 0; w < EVAL_WEIGHT_COUNT; w++) {
+            if (w == EVAL_VALUE_INDEX(KING)) continue;
+            moment[w] = beta1 * moment[w] + (1.0 - beta1) * gradient[w];
+            velocity[w] = beta2 * velocity[w] + (1.0 - beta2) * gradient[w] * gradient[w];
+            double correctedMoment = moment[w] / (1.0 - pow(beta1, epoch));
+            double correctedVelocity = velocity[w] / (1.0 - pow(beta2, epoch));
+            weights[w] -= rate * correctedMoment / (sqrt(correctedVelocity) + 1e-12);
+        }
+        if (epoch == 1 || epoch % 50 == 0 || epoch == epochs) {
+            printf("Epoch %d: loss %.6f (%lld ms)\n", epoch, loss, platformMilliseconds() - started);
+            fflush(stdout);
+        }
+    }
+
+    printf("Final loss %.6f\n", evaluateLoss(&data, weights, k, slices, threads, NULL));
+    bool ok = writeHeader(output, weights);
+    if (ok) printf("Weights written to %s\n", output);
+    else fprintf(stderr, "Cannot write %s\n", output);
+
+    free(slices);
+    free(data.pieces);
+    free(data.offsets);
+    free(data.results);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+#include "book.h"
+#include "fen.h"
+#include "platform.h"
+#include "search.h"
+#include "tbprobe.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Headless engine speaking the UCI protocol on stdin/stdout:
+//   chess_uci
+//
+// The main thread only parses input; searches run in the background so
+// stop and ponderhit are handled at once. Output is fully buffered and
+// info lines are flushed at most every INFO_FLUSH_MS, so a fast stream of
+// shallow iterations does not turn into one system call per line. A
+// background thread flushes lines held back longer than that, so the last
+// lines of a burst appear even when the search then goes quiet.
+
+#define ENGINE_NAME "chess-raylib"
+#define INFO_FLUSH_MS 100
+#define MAX_GAME_PLIES 2048
+
+typedef struct {
+    GameState game;
+    uint64_t history[MAX_GAME_PLIES];
+    int historyLength;
+
+    int hashMegabytes;
+    int threads;
+    bool ownBook;
+    OpeningBook book;
+    bool bookOpen;
+    uint64_t bookSeed;
+
+    bool searching;
+    pthread_t reporter;
+} Engine;
+
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t outputHeld = PTHREAD_COND_INITIALIZER;
+static long long lastFlush;
+static bool outputPending;   // Lines written since the last flush
+static bool flusherRunning;  // Without it every line is flushed at once
+
+static void sendLine(bool flush, const char *format, ...) {
+    pthread_mutex_lock(&outputLock);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+
+    long long now = platformMilliseconds();
+    if (flush || !flusherRunning || now - lastFlush >= INFO_FLUSH_MS) {
+        fflush(stdout);
+        lastFlush = now;
+        outputPending = false;
+    } else if (!outputPending) {
+        outputPending = true;
+        pthread_cond_signal(&outputHeld);
+    }
+    pthread_mutex_unlock(&outputLock);
+}
+
+// Flushes lines that sendLine held back once INFO_FLUSH_MS has passed
+static void *flushHeldOutput(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&outputLock);
+    for (;;) {
+        while (!outputPending) pthread_cond_wait(&outputHeld, &outputLock);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long long nanoseconds = deadline.tv_nsec + INFO_FLUSH_MS * 1000000LL;
+        deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+        deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+        while (outputPending && pthread_cond_timedwait(&outputHeld, &outputLock, &deadline) == 0) {}
+
+        if (outputPending) {
+            fflush(stdout);
+            lastFlush = platformMilliseconds();
+            outputPending = false;
+        }
+    }
+    return NULL;
+}
+
+// Writes a move in coordinate notation and returns its length
+static int moveToUci(Move move, char text[6]) {
+    int length = 0;
+    text[length++] = (char)('a' + MOVE_FROM_X(move));
+    text[length++] = (char)('8' - MOVE_FROM_Y(move));
+    text[length++] = (char)('a' + MOVE_TO_X(move));
+    text[length++] = (char)('8' - MOVE_TO_Y(move));
+    if (MOVE_KIND(move) == MOVE_PROMOTION) text[length++] = "  nbrq"[MOVE_PROMOTION_PIECE(move)];
+    text[length] = '\0';
+    return length;
+}
+
+// Plays a move in coordinate notation such as "e2e4" or "e7e8q"
+static bool playUciMove(Engine *engine, const char *text) {
+    size_t textLength = strlen(text);
+    if (textLength != 4 && textLength != 5) return false;
+    int fromX = text[0] - 'a', fromY = '8' - text[1], toX = text[2] - 'a', toY = '8' - text[3];
+    if (fromX < 0 || fromX > 7 || fromY < 0 || fromY > 7 || toX < 0 || toX > 7 || toY < 0 || toY > 7) {
+        return false;
+    }
+    PieceType promotion = EMPTY;
+    if (textLength == 5) {
+        const char *piece = strchr("nbrq", text[4]);
+        if (!piece) return false;
+        promotion = (PieceType)(KNIGHT + (piece - "nbrq"));
+    }
+    Move move = moveFromSquares(&engine->game, fromX, fromY, toX, toY, promotion);
+    // A promotion must name its piece, and only a promotion may
+    if ((MOVE_KIND(move) == MOVE_PROMOTION) != (promotion != EMPTY)) return false;
+    if (engine->historyLength == MAX_GAME_PLIES) return false;
+
+    uint64_t key = zobristKey(&engine->game);
+    if (!makeMove(&engine->game, move)) return false;
+    engine->history[engine->historyLength++] = key;
+    return true;
+}
+
+static void onInfo(const SearchInfo *info, void *context) {
+    (void)context;
+    char line[64 + SEARCH_MAX_PLY * 6];
+    int length = 0;
+    for (int i = 0; i < info->pvLength; i++) {
+        line[length++] = ' ';
+        length += moveToUci(info->pv[i], line + length);
+    }
+    line[length] = '\0';
+
+    long long nps = info->timeMs > 0 ? info->nodes * 1000 / info->timeMs : 0;
+    if (info->score > SCORE_MATE_BOUND || info->score < -SCORE_MATE_BOUND) {
+        int plies = SCORE_MATE - abs(info->score);
+        int moves = info->score > 0 ? (plies + 1) / 2 : -(plies / 2);
+        sendLine(false, "info depth %d score mate %d nodes %lld nps %lld time %lld pv%s",
+                 info->depth, moves, info->nodes, nps, info->timeMs, line);
+    } else {
+        sendLine(false, "info depth %d score cp %d nodes %lld nps %lld time %lld pv%s",
+                 info->depth, info->score, info->nodes, nps, info->timeMs, line);
+    }
+}
+
+static void *reportBestMove(void *arg) {
+    (void)arg;
+    Move best, ponder;
+    if (!searchWait(&best, &ponder)) return NULL;
+
+    char bestText[6], ponderText[6];
+    moveToUci(best, bestText);
+    if (ponder != MOVE_NONE) {
+        moveToUci(ponder, ponderText);
+        sendLine(true, "bestmove %s ponder %s", bestText, ponderText);
+    } else {
+        sendLine(true, "bestmove %s", bestText);
+    }
+    return NULL;
+}
+
+// Waits for the running search, if any, to report its move
+static void finishSearch(Engine *engine, bool stop) {
+    if (!engine->searching) return;
+    if (stop) searchStop();
+    pthread_join(engine->reporter, NULL);
+    engine->searching = false;
+}
+
+static void handlePosition(Engine *engine, char *args) {
+    char *moves = strstr(args, " moves");
+    if (moves) *moves = '\0';
+
+    GameState game;
+    if (strncmp(args, "startpos", 8) == 0) {
+        game = initializeGame();
+    } else if (strncmp(args, "fen ", 4) == 0) {
+        if (!gameFromFEN(args + 4, &game)) {
+            sendLine(true, "info string invalid fen");
+            return;
+        }
+    } else {
+        return;
+    }
+    engine->game = game;
+    engine->historyLength = 0;
+
+    if (!moves) return;
+    for (char *token = strtok(moves + 6, " "); token; token = strtok(NULL, " ")) {
+        if (!playUciMove(engine, token)) {
+            sendLine(true, "info string cannot play %s", token);
+            return;
+        }
+    }
+}
+
+static void handleGo(Engine *engine, char *args) {
+    SearchLimits limits;
+    memset(&limits, 0, sizeof(limits));
+
+    for (char *token = strtok(args, " "); token; token = strtok(NULL, " ")) {
+        char *value = NULL;
+        if (strcmp(token, "infinite") == 0) {
+            limits.infinite = true;
+        } else if (strcmp(token, "ponder") == 0) {
+            limits.ponder = true;
+        } else if ((value = strtok(NULL, " ")) != NULL) {
+            long long number = atoll(value);
+            if (strcmp(token, "depth") == 0) limits.depth = (int)number;
+            else if (strcmp(token, "nodes") == 0) limits.nodes = number;
+            else if (strcmp(token, "movetime") == 0) limits.moveTime = (int)number;
+            else if (strcmp(token, "wtime") == 0) limits.time[0] = (int)number;
+            else if (strcmp(token, "btime") == 0) limits.time[1] = (int)number;
+            else if (strcmp(token, "winc") == 0) limits.increment[0] = (int)number;
+            else if (strcmp(token, "binc") == 0) limits.increment[1] = (int)number;
+            else if (strcmp(token, "movestogo") == 0) limits.movesToGo = (int)number;
+        }
+    }
+
+    // Book moves are answered at once, without a search
+    Move move;
+    if (engine->ownBook && engine->bookOpen && !limits.ponder && !limits.infinite &&
+        bookPickMove(&engine->book, &engine->game, &engine->bookSeed, &move)) {
+        char text[6];
+        moveToUci(move, text);
+        sendLine(true, "bestmove %s", text);
+        return;
+    }
+
+    if (!searchStart(&engine->game, engine->history, engine->historyLength, &limits,
+                     engine->threads, onInfo, NULL)) {
+        sendLine(true, "bestmove 0000");
+        return;
+    }
+    if (pthread_create(&engine->reporter, NULL, reportBestMove, NULL) != 0) {
+        searchStop();
+        reportBestMove(NULL);
+        return;
+    }
+    engine->searching = true;
+}
+
+static void handleSetOption(Engine *engine, char *args) {
+    char *name = strstr(args, "name ");
+    if (!name) return;
+    name += 5;
+    char *value = strstr(name, " value ");
+    if (value) {
+        *value = '\0';
+        value += 7;
+    } else {
+        value = "";
+    }
+
+    if (strcmp(name, "Hash") == 0) {
+        engine->hashMegabytes = atoi(value);
+        if (!searchSetHash((size_t)engine->hashMegabytes)) {
+            sendLine(true, "info string cannot allocate %d MB", engine->hashMegabytes);
+        }
+    } else if (strcmp(name, "Threads") == 0) {
+        engine->threads = atoi(value);
+    } else if (strcmp(name, "OwnBook") == 0) {
+        engine->ownBook = strcmp(value, "true") == 0;
+    } else if (strcmp(name, "BookFile") == 0) {
+        if (engine->bookOpen) bookClose(&engine->book);
+        engine->bookOpen = bookOpen(&engine->book, value);
+        if (!engine->bookOpen && *value) sendLine(true, "info string cannot open book %s", value);
+    } else if (strcmp(name, "TablebasePath") == 0) {
+        tbProbeClose();
+        if (*value) {
+            int tables = tbProbeInit(value, TB_DEFAULT_CACHE_BYTES);
+            sendLine(true, "info string %d tablebase files found", tables);
+        }
+    }
+    // Ponder needs no setup: the GUI decides when to ponder
+}
+
+int main(void) {
+    static Engine engine;
+    engine.game = initializeGame();
+    engine.hashMegabytes = SEARCH_DEFAULT_HASH_MB;
+    engine.threads = 1;
+    engine.bookSeed = (uint64_t)platformMilliseconds();
+    searchSetHash((size_t)engine.hashMegabytes);
+
+    static char outputBuffer[1 << 16];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    pthread_t flusher;
+    flusherRunning = pthread_create(&flusher, NULL, flushHeldOutput, NULL) == 0;
+    if (flusherRunning) pthread_detach(flusher);
+
+    char line[1 << 16];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *args = strchr(line, ' ');
+        if (args) *args++ = '\0';
+        else args = line + strlen(line);
+
+        if (strcmp(line, "uci") == 0) {
+            sendLine(false, "id name " ENGINE_NAME);
+            sendLine(false, "id author chess-raylib contributors");
+            sendLine(false, "option name Hash type spin default %d min 1 max 65536", SEARCH_DEFAULT_HASH_MB);
+            sendLine(false, "option name Threads type spin default 1 min 1 max %d", SEARCH_MAX_THREADS);
+            sendLine(false, "option name Ponder type check default false");
+            sendLine(false, "option name OwnBook type check default false");
+            sendLine(false, "option name BookFile type string default <empty>");
+            sendLine(false, "option name TablebasePath type string default <empty>");
+            sendLine(true, "uciok");
+        } else if (strcmp(line, "isready") == 0) {
+            sendLine(true, "readyok");
+        } else if (strcmp(line, "ucinewgame") == 0) {
+            finishSearch(&engine, true);
+            searchClearHash();
+        } else if (strcmp(line, "setoption") == 0) {
+            finishSearch(&engine, true);
+            handleSetOption(&engine, args);
+        } else if (strcmp(line, "position") == 0) {
+            finishSearch(&engine, true);
+            handlePosition(&engine, args);
+        } else if (strcmp(line, "go") == 0) {
+            finishSearch(&engine, true);
+            handleGo(&engine, args);
+        } else if (strcmp(line, "stop") == 0) {
+            finishSearch(&engine, true);
+        } else if (strcmp(line, "ponderhit") == 0) {
+            searchPonderHit();
+        } else if (strcmp(line, "quit") == 0) {
+            break;
+        }
+    }
+
+    finishSearch(&engine, true);
+    if (engine.bookOpen) bookClose(&engine.book);
+    tbProbeClose();
+    fflush(stdout);
+    return 0;
+}